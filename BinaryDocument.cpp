@@ -0,0 +1,346 @@
+#include "BinaryDocument.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace nlohmann;
+
+static constexpr size_t OBJECT_HEADER = 2 * sizeof(uint32_t);  // размер и число полей
+static constexpr size_t FIELD_ENTRY = 2 * sizeof(uint32_t);    // номер имени, значение
+static constexpr size_t ARRAY_HEADER = 2 * sizeof(uint32_t);   // размер и число элементов
+static constexpr size_t NUMBER_BYTES = 8;
+
+using Type = BinaryDocument::Type;
+
+// буфер не выровнен, поэтому числа читаются и пишутся через memcpy
+template<typename T>
+static T readAt(const char* pos) {
+    T value;
+    memcpy(&value, pos, sizeof(T));
+    return value;
+}
+
+template<typename T>
+static void writeAt(char* pos, const T value) {
+    memcpy(pos, &value, sizeof(T));
+}
+
+static size_t objectSize(const json::object_t& object);
+
+static size_t valueSize(const json& value) {
+    switch (value.type()) {
+        case json::value_t::number_integer:
+        case json::value_t::number_unsigned:
+        case json::value_t::number_float:
+            return 1 + NUMBER_BYTES;
+        case json::value_t::string:
+            return 1 + sizeof(uint32_t) + value.get_ref<const string&>().size();
+        case json::value_t::binary:
+            return 1 + (value.get_binary().has_subtype() ? NUMBER_BYTES : 0) + sizeof(uint32_t)
+                   + value.get_binary().size();
+        case json::value_t::array: {
+            size_t total = 1 + ARRAY_HEADER;
+            for (const auto& item : value) total += valueSize(item);
+            return total;
+        }
+        case json::value_t::object:
+            return 1 + objectSize(value.get_ref<const json::object_t&>());
+        default:
+            return 1;
+    }
+}
+
+static size_t objectSize(const json::object_t& object) {
+    size_t total = OBJECT_HEADER + object.size() * FIELD_ENTRY;
+    for (const auto& [name, value] : object) total += valueSize(value);
+    return total;
+}
+
+static char* writeObject(char* begin, const json::object_t& object, FieldDictionary& fields);
+
+static char* writeValue(char* out, const json& value, FieldDictionary& fields) {
+    switch (value.type()) {
+        case json::value_t::boolean:
+            *out = static_cast<char>(value.get<bool>() ? Type::True : Type::False);
+            return out + 1;
+        case json::value_t::number_integer:
+            *out = static_cast<char>(Type::Integer);
+            writeAt(out + 1, value.get<int64_t>());
+            return out + 1 + NUMBER_BYTES;
+        case json::value_t::number_unsigned:
+            *out = static_cast<char>(Type::Unsigned);
+            writeAt(out + 1, value.get<uint64_t>());
+            return out + 1 + NUMBER_BYTES;
+        case json::value_t::number_float:
+            *out = static_cast<char>(Type::Float);
+            writeAt(out + 1, value.get<double>());
+            return out + 1 + NUMBER_BYTES;
+        case json::value_t::string: {
+            const string& text = value.get_ref<const string&>();
+            *out = static_cast<char>(Type::String);
+            writeAt(out + 1, static_cast<uint32_t>(text.size()));
+            memcpy(out + 1 + sizeof(uint32_t), text.data(), text.size());
+            return out + 1 + sizeof(uint32_t) + text.size();
+        }
+        case json::value_t::binary: {
+            const auto& bytes = value.get_binary();
+            *out++ = static_cast<char>(bytes.has_subtype() ? Type::TypedBinary : Type::Binary);
+            if (bytes.has_subtype()) {
+                writeAt(out, static_cast<uint64_t>(bytes.subtype()));
+                out += NUMBER_BYTES;
+            }
+            writeAt(out, static_cast<uint32_t>(bytes.size()));
+            if (!bytes.empty()) memcpy(out + sizeof(uint32_t), bytes.data(), bytes.size());
+            return out + sizeof(uint32_t) + bytes.size();
+        }
+        case json::value_t::array: {
+            *out = static_cast<char>(Type::Array);
+            char* header = out + 1;
+            char* pos = header + ARRAY_HEADER;
+            for (const auto& item : value) pos = writeValue(pos, item, fields);
+            writeAt(header, static_cast<uint32_t>(pos - header));
+            writeAt(header + sizeof(uint32_t), static_cast<uint32_t>(value.size()));
+            return pos;
+        }
+        case json::value_t::object:
+            *out = static_cast<char>(Type::Object);
+            return writeObject(out + 1, value.get_ref<const json::object_t&>(), fields);
+        default:
+            *out = static_cast<char>(Type::Null);
+            return out + 1;
+    }
+}
+
+static char* writeObject(char* begin, const json::object_t& object, FieldDictionary& fields) {
+    // номера идут в порядке появления имён, а не по алфавиту, поэтому поля
+    // сортируются заново
+    vector<pair<uint32_t, const json*>> order;
+    order.reserve(object.size());
+    for (const auto& [name, value] : object) order.emplace_back(fields.intern(name), &value);
+    sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    char* entry = begin + OBJECT_HEADER;
+    char* pos = entry + order.size() * FIELD_ENTRY;
+    for (const auto& [field, value] : order) {
+        writeAt(entry, field);
+        writeAt(entry + sizeof(uint32_t), static_cast<uint32_t>(pos - begin));
+        pos = writeValue(pos, *value, fields);
+        entry += FIELD_ENTRY;
+    }
+    writeAt(begin, static_cast<uint32_t>(pos - begin));
+    writeAt(begin + sizeof(uint32_t), static_cast<uint32_t>(order.size()));
+    return pos;
+}
+
+static const char* skipValue(const char* pos) {
+    switch (static_cast<Type>(*pos)) {
+        case Type::Integer:
+        case Type::Unsigned:
+        case Type::Float:
+            return pos + 1 + NUMBER_BYTES;
+        case Type::String:
+        case Type::Binary:
+            return pos + 1 + sizeof(uint32_t) + readAt<uint32_t>(pos + 1);
+        case Type::TypedBinary:
+            return pos + 1 + NUMBER_BYTES + sizeof(uint32_t) + readAt<uint32_t>(pos + 1 + NUMBER_BYTES);
+        case Type::Array:
+        case Type::Object:
+            return pos + 1 + readAt<uint32_t>(pos + 1);
+        default:
+            return pos + 1;
+    }
+}
+
+static json objectToJson(const char* begin, const FieldDictionary& fields);
+
+static json valueToJson(const char* pos, const FieldDictionary& fields) {
+    switch (static_cast<Type>(*pos)) {
+        case Type::False: return false;
+        case Type::True: return true;
+        case Type::Integer: return readAt<int64_t>(pos + 1);
+        case Type::Unsigned: return readAt<uint64_t>(pos + 1);
+        case Type::Float: return readAt<double>(pos + 1);
+        case Type::String:
+            return string(pos + 1 + sizeof(uint32_t), readAt<uint32_t>(pos + 1));
+        case Type::Binary: {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(pos + 1 + sizeof(uint32_t));
+            return json::binary(vector<uint8_t>(bytes, bytes + readAt<uint32_t>(pos + 1)));
+        }
+        case Type::TypedBinary: {
+            const char* length = pos + 1 + NUMBER_BYTES;
+            const auto* bytes = reinterpret_cast<const uint8_t*>(length + sizeof(uint32_t));
+            return json::binary(vector<uint8_t>(bytes, bytes + readAt<uint32_t>(length)), readAt<uint64_t>(pos + 1));
+        }
+        case Type::Array: {
+            json result = json::array();
+            auto& items = result.get_ref<json::array_t&>();
+            const uint32_t count = readAt<uint32_t>(pos + 1 + sizeof(uint32_t));
+            items.reserve(count);
+            const char* item = pos + 1 + ARRAY_HEADER;
+            for (uint32_t i = 0; i < count; i++) {
+                items.push_back(valueToJson(item, fields));
+                item = skipValue(item);
+            }
+            return result;
+        }
+        case Type::Object:
+            return objectToJson(pos + 1, fields);
+        default:
+            return nullptr;
+    }
+}
+
+static json objectToJson(const char* begin, const FieldDictionary& fields) {
+    json result = json::object();
+    auto& object = result.get_ref<json::object_t&>();
+    const uint32_t count = readAt<uint32_t>(begin + sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        const char* entry = begin + OBJECT_HEADER + i * FIELD_ENTRY;
+        object.emplace(fields.name(readAt<uint32_t>(entry)),
+                       valueToJson(begin + readAt<uint32_t>(entry + sizeof(uint32_t)), fields));
+    }
+    return result;
+}
+
+static bool validObject(const char* begin, const char* end, const FieldDictionary& fields);
+
+// значение по адресу pos целиком лежит до end
+static bool validValue(const char* pos, const char* end, const FieldDictionary& fields) {
+    if (pos >= end) return false;
+    const auto left = static_cast<size_t>(end - pos) - 1;
+    switch (static_cast<Type>(*pos)) {
+        case Type::Null:
+        case Type::False:
+        case Type::True:
+            return true;
+        case Type::Integer:
+        case Type::Unsigned:
+        case Type::Float:
+            return left >= NUMBER_BYTES;
+        case Type::String:
+        case Type::Binary:
+            return left >= sizeof(uint32_t) && readAt<uint32_t>(pos + 1) <= left - sizeof(uint32_t);
+        case Type::TypedBinary:
+            return left >= NUMBER_BYTES + sizeof(uint32_t)
+                   && readAt<uint32_t>(pos + 1 + NUMBER_BYTES) <= left - NUMBER_BYTES - sizeof(uint32_t);
+        case Type::Array: {
+            if (left < ARRAY_HEADER) return false;
+            const uint32_t size = readAt<uint32_t>(pos + 1);
+            if (size < ARRAY_HEADER || size > left) return false;
+            const char* arrayEnd = pos + 1 + size;
+            const uint32_t count = readAt<uint32_t>(pos + 1 + sizeof(uint32_t));
+            const char* item = pos + 1 + ARRAY_HEADER;
+            for (uint32_t i = 0; i < count; i++) {
+                if (!validValue(item, arrayEnd, fields)) return false;
+                item = skipValue(item);
+            }
+            return item == arrayEnd;
+        }
+        case Type::Object:
+            return validObject(pos + 1, end, fields);
+    }
+    return false;
+}
+
+static bool validObject(const char* begin, const char* end, const FieldDictionary& fields) {
+    const auto available = static_cast<size_t>(end - begin);
+    if (available < OBJECT_HEADER) return false;
+    const uint32_t size = readAt<uint32_t>(begin);
+    const uint32_t count = readAt<uint32_t>(begin + sizeof(uint32_t));
+    if (size < OBJECT_HEADER || size > available || count > (size - OBJECT_HEADER) / FIELD_ENTRY) return false;
+
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const char* entry = begin + OBJECT_HEADER + i * FIELD_ENTRY;
+        // двоичный поиск в find полагается на порядок номеров
+        const uint32_t field = readAt<uint32_t>(entry);
+        if (field >= fields.size() || (i > 0 && field <= previous)) return false;
+        previous = field;
+        if (!validValue(begin + readAt<uint32_t>(entry + sizeof(uint32_t)), begin + size, fields)) return false;
+    }
+    return true;
+}
+
+string_view BinaryDocument::Value::string() const {
+    return {pos + 1 + sizeof(uint32_t), readAt<uint32_t>(pos + 1)};
+}
+
+json BinaryDocument::Value::toJson(const FieldDictionary &fields) const {
+    return pos == nullptr ? json() : valueToJson(pos, fields);
+}
+
+BinaryDocument::BinaryDocument(const nlohmann::json &doc, FieldDictionary &fields) {
+    if (!doc.is_object()) throw runtime_error("Документ должен быть объектом");
+    const auto& object = doc.get_ref<const json::object_t&>();
+    const size_t length = objectSize(object);
+    if (length > UINT32_MAX) throw runtime_error("Документ слишком большой");
+
+    data = static_cast<char*>(malloc(length));
+    if (data == nullptr) throw bad_alloc();
+    try {
+        writeObject(data, object, fields);
+    } catch (...) {
+        free(data);
+        throw;
+    }
+}
+
+BinaryDocument::~BinaryDocument() {
+    free(data);
+}
+
+BinaryDocument::BinaryDocument(BinaryDocument &&other) noexcept : data(std::exchange(other.data, nullptr)) {}
+
+BinaryDocument& BinaryDocument::operator=(BinaryDocument &&other) noexcept {
+    if (this != &other) {
+        free(data);
+        data = std::exchange(other.data, nullptr);
+    }
+    return *this;
+}
+
+BinaryDocument BinaryDocument::fromBytes(const char *bytes, const size_t length, const FieldDictionary &fields) {
+    if (!validObject(bytes, bytes + length, fields) || readAt<uint32_t>(bytes) != length) {
+        throw runtime_error("Повреждённый документ");
+    }
+    BinaryDocument doc;
+    doc.data = static_cast<char*>(malloc(length));
+    if (doc.data == nullptr) throw bad_alloc();
+    memcpy(doc.data, bytes, length);
+    return doc;
+}
+
+BinaryDocument::Value BinaryDocument::find(const uint32_t field) const {
+    if (data == nullptr) return {};
+    size_t low = 0, high = fieldCount();
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        const char* entry = data + OBJECT_HEADER + middle * FIELD_ENTRY;
+        const uint32_t current = readAt<uint32_t>(entry);
+        if (current == field) return Value(data + readAt<uint32_t>(entry + sizeof(uint32_t)));
+        if (current < field) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return {};
+}
+
+uint32_t BinaryDocument::fieldCount() const {
+    return data == nullptr ? 0 : readAt<uint32_t>(data + sizeof(uint32_t));
+}
+
+size_t BinaryDocument::size() const {
+    return data == nullptr ? 0 : readAt<uint32_t>(data);
+}
+
+json BinaryDocument::toJson(const FieldDictionary &fields) const {
+    return data == nullptr ? json::object() : objectToJson(data, fields);
+}
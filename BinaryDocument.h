@@ -0,0 +1,74 @@
+#ifndef PROVERKA_BINARYDOCUMENT_H
+#define PROVERKA_BINARYDOCUMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "FieldDictionary.h"
+#include "json.hpp"
+
+// Документ коллекции в одном непрерывном буфере вместо дерева nlohmann::json.
+//
+// Объект: uint32 размер, uint32 число полей, таблица полей, значения.
+// Запись таблицы — номер имени поля в словаре коллекции (FieldDictionary)
+// и смещение значения от начала объекта; записи отсортированы по номеру,
+// поэтому find ищет поле двоичным поиском по числам и сразу получает его
+// значение, не разбирая соседей. Значение — байт типа и данные: числа по
+// 8 байт, строки и двоичные данные с uint32 длиной (двоичные с подтипом CBOR —
+// ещё и с uint64 подтипом перед длиной), массив с uint32 размером и числом
+// элементов, вложенный объект в том же формате. Все числа в порядке
+// байт машины.
+//
+// В nlohmann::json документ превращается только на выходе (toJson), имена
+// полей при этом берутся из того же словаря.
+class BinaryDocument {
+public:
+    enum class Type : uint8_t { Null, False, True, Integer, Unsigned, Float, String, Binary, Array, Object, TypedBinary };
+
+    // Значение внутри буфера документа; живёт, пока жив документ
+    class Value {
+    private:
+        const char* pos = nullptr;
+    public:
+        Value() = default;
+        explicit Value(const char* position) : pos(position) {}
+
+        explicit operator bool() const { return pos != nullptr; }
+        [[nodiscard]] Type type() const { return static_cast<Type>(*pos); }
+        [[nodiscard]] bool isNumber() const {
+            return type() == Type::Integer || type() == Type::Unsigned || type() == Type::Float;
+        }
+        [[nodiscard]] bool isString() const { return type() == Type::String; }
+        // только для строк
+        [[nodiscard]] std::string_view string() const;
+        // числа, bool и null превращаются в json без выделения памяти
+        [[nodiscard]] nlohmann::json toJson(const FieldDictionary& fields) const;
+    };
+
+    BinaryDocument() = default;
+    // doc должен быть объектом; новые имена полей добавляются в fields
+    BinaryDocument(const nlohmann::json& doc, FieldDictionary& fields);
+    ~BinaryDocument();
+
+    BinaryDocument(const BinaryDocument&) = delete;
+    BinaryDocument& operator=(const BinaryDocument&) = delete;
+    BinaryDocument(BinaryDocument&& other) noexcept;
+    BinaryDocument& operator=(BinaryDocument&& other) noexcept;
+
+    // документ из байтов снимка; проверяет, что все смещения внутри буфера,
+    // а номера полей есть в fields
+    static BinaryDocument fromBytes(const char* bytes, size_t length, const FieldDictionary& fields);
+
+    [[nodiscard]] Value find(uint32_t field) const;
+    [[nodiscard]] uint32_t fieldCount() const;
+    [[nodiscard]] nlohmann::json toJson(const FieldDictionary& fields) const;
+
+    [[nodiscard]] const char* bytes() const { return data; }
+    [[nodiscard]] size_t size() const;
+private:
+    char* data = nullptr;
+};
+
+
+#endif //PROVERKA_BINARYDOCUMENT_H
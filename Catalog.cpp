@@ -0,0 +1,38 @@
+#include "Catalog.h"
+
+#include <functional>
+#include <shared_mutex>
+
+using namespace std;
+
+array<Catalog::Shard, Catalog::SHARDS> Catalog::shards;
+
+Catalog::Entry& Catalog::findOrAdd(const std::string& key) {
+    Shard& shard = shards[hash<string>{}(key) % SHARDS];
+    {
+        shared_lock<RwLock> lock(shard.lock);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            return *it->second;
+        }
+    }
+    unique_lock<RwLock> lock(shard.lock);
+    auto& entry = shard.entries[key];
+    if (!entry) {
+        entry = make_unique<Entry>();
+    }
+    return *entry;
+}
+
+Collection& Catalog::getCollection(const std::string &database, const std::string &collection) {
+    Entry& entry = findOrAdd(database + "/" + collection);
+
+    // загружает ровно один поток, остальные ждут его здесь; если загрузка
+    // бросит исключение, следующий вызов попробует ещё раз
+    call_once(entry.loaded, [&] {
+        auto coll = make_unique<Collection>(database, collection);
+        coll->load();
+        entry.collection = std::move(coll);
+    });
+    return *entry.collection;
+}
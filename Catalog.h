@@ -0,0 +1,42 @@
+#ifndef PROVERKA_CATALOG_H
+#define PROVERKA_CATALOG_H
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Collection.h"
+#include "RwLock.h"
+
+// Каталог коллекций, загруженных в память. Каждая коллекция читается с диска
+// один раз, при первом обращении, и дальше живёт в памяти до конца процесса.
+//
+// Каталог разбит на сегменты по хешу имени, у каждого своя блокировка
+// чтения-записи. Поиск уже загруженной коллекции берёт её на чтение и не
+// мешает другим потокам; запись нужна, только чтобы добавить новую запись,
+// а чтение файлов идёт уже вне блокировки сегмента.
+class Catalog {
+private:
+    static constexpr size_t SHARDS = 64;
+
+    struct Entry {
+        std::once_flag loaded;
+        std::unique_ptr<Collection> collection;
+    };
+
+    struct Shard {
+        RwLock lock;
+        std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    };
+
+    static std::array<Shard, SHARDS> shards;
+
+    static Entry& findOrAdd(const std::string& key);
+public:
+    static Collection& getCollection(const std::string& database, const std::string& collection);
+};
+
+
+#endif //PROVERKA_CATALOG_H
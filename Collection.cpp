@@ -0,0 +1,276 @@
+#include "Collection.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+using namespace nlohmann;
+
+static string prepareDirectory(const string& database) {
+    filesystem::create_directories(database);
+    return database;
+}
+
+static void syncFile(const string& path) {
+    if (const int fd = open(path.c_str(), O_RDONLY); fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+Collection::Collection(const std::string &database, const std::string &name) :
+                        snapshotPath(database + "/" + name + ".snap"),
+                        legacyPath(database + "/" + name + ".json"),
+                        indexPath(database + "/" + name + ".indexes"),
+                        map(3),
+                        wal(prepareDirectory(database) + "/" + name + ".wal") {}
+
+void Collection::load() {
+    // коллекции, сохранённые до перехода на бинарный снимок, читаются из JSON
+    if (filesystem::exists(snapshotPath)) {
+        map.loadFromFile(snapshotPath);
+    } else {
+        map.loadFromFile(legacyPath);
+    }
+    wal.replay(map);
+    map.publish();
+
+    json list = json::array();
+    if (ifstream file(indexPath); file.is_open()) {
+        try {
+            file >> list;
+        } catch (...) {
+            cerr << "Список индексов " << indexPath << " повреждён — индексы не загружены" << endl;
+        }
+    }
+    for (const auto& entry : list) {
+        // раньше в списке хранились только имена полей хеш-индексов
+        if (entry.is_string()) {
+            buildIndex(entry.get<string>(), "hash");
+        } else if (entry.is_object() && entry.contains("field") && entry["field"].is_string()) {
+            buildIndex(entry["field"].get<string>(), entry.value("type", "hash"));
+        }
+    }
+}
+
+void Collection::insert(const std::string &id, const json &doc) {
+    if (wal.isBroken()) recoverLog();
+
+    // имена полей попадают в словарь раньше журнала: если словарь полон,
+    // вставка отклоняется, не оставив в журнале записи, которую нельзя повторить
+    BinaryDocument encoded(doc, map.getFields());
+    const uint64_t ticket = wal.logInsert(doc);
+    forgetConfirmed();
+    unconfirmed.push_back({ticket, id, string()});
+    const BinaryDocument& stored = map.hashMapInsert(id, std::move(encoded));
+    {
+        lock_guard<RwLock> lock(indexLock);
+        for (auto& [field, index] : indexes) {
+            index.add(id, stored);
+        }
+        for (auto& [field, index] : rangeIndexes) {
+            index.add(id, stored);
+        }
+        map.publish();
+    }
+    checkpointIfNeeded();
+}
+
+size_t Collection::erase(const MyVector<std::string> &ids) {
+    if (wal.isBroken()) recoverLog();
+    forgetConfirmed();
+
+    size_t removed = 0;
+    {
+        lock_guard<RwLock> lock(indexLock);
+        for (const auto& id : ids) {
+            const BinaryDocument* doc = map.findById(id);
+            if (doc == nullptr) continue;
+
+            const uint64_t ticket = wal.logDelete(id);
+            unconfirmed.push_back({ticket, id, string(doc->bytes(), doc->size())});
+            for (auto& [field, index] : indexes) {
+                index.remove(id, *doc);
+            }
+            for (auto& [field, index] : rangeIndexes) {
+                index.remove(id, *doc);
+            }
+            if (map.deleteById(id)) removed++;
+        }
+        if (removed == 0) return 0;
+        map.publish();
+    }
+    checkpointIfNeeded();
+    return removed;
+}
+
+void Collection::waitDurable(const uint64_t ticket) {
+    try {
+        wal.waitDurable(ticket);
+    } catch (const LogWriteError&) {
+        lock_guard<mutex> lock(writeLock);
+        if (wal.isBroken()) {
+            try {
+                recoverLog();
+            } catch (const exception& e) {
+                cerr << e.what() << endl;
+            }
+        }
+        throw;
+    }
+}
+
+void Collection::forgetConfirmed() {
+    const uint64_t durable = wal.durableThrough();
+    while (!unconfirmed.empty() && unconfirmed.front().ticket <= durable) {
+        unconfirmed.pop_front();
+    }
+}
+
+void Collection::rollbackUnconfirmed() {
+    // после ошибки журнал больше ничего не подтверждает, и всё, что новее
+    // durableThrough, потеряно; отменяем в обратном порядке
+    const uint64_t durable = wal.durableThrough();
+    lock_guard<RwLock> lock(indexLock);
+    while (!unconfirmed.empty() && unconfirmed.back().ticket > durable) {
+        const Unconfirmed& change = unconfirmed.back();
+        if (change.previous.empty()) {
+            if (const BinaryDocument* doc = map.findById(change.id)) {
+                for (auto& [field, index] : indexes) {
+                    index.remove(change.id, *doc);
+                }
+                for (auto& [field, index] : rangeIndexes) {
+                    index.remove(change.id, *doc);
+                }
+                map.deleteById(change.id);
+            }
+        } else {
+            const BinaryDocument& stored = map.hashMapInsert(change.id, BinaryDocument::fromBytes(
+                    change.previous.data(), change.previous.size(), map.getFields()));
+            for (auto& [field, index] : indexes) {
+                index.add(change.id, stored);
+            }
+            for (auto& [field, index] : rangeIndexes) {
+                index.add(change.id, stored);
+            }
+        }
+        unconfirmed.pop_back();
+    }
+    unconfirmed.clear();
+    map.publish();
+}
+
+void Collection::recoverLog() {
+    rollbackUnconfirmed();
+    if (wal.discardLost()) return;
+
+    // в журнале мог остаться обрывок пакета: его заменит только новый снимок
+    try {
+        checkpoint();
+    } catch (const LogWriteError&) {
+        throw;
+    } catch (const exception& e) {
+        throw LogWriteError(string("Журнал коллекции недоступен: ") + e.what());
+    }
+}
+
+void Collection::checkpoint() {
+    // в снимок попадают только подтверждённые изменения: очередь журнала
+    // сначала сбрасывается на диск, а если это не удалось — откатывается
+    try {
+        wal.waitDurable(wal.currentTicket());
+    } catch (const LogWriteError&) {
+        rollbackUnconfirmed();
+    }
+
+    const string tmpPath = snapshotPath + ".tmp";
+    map.saveToFile(tmpPath);
+    syncFile(tmpPath);
+    filesystem::rename(tmpPath, snapshotPath);
+    wal.truncate();
+    unconfirmed.clear();
+    filesystem::remove(legacyPath);
+}
+
+void Collection::checkpointIfNeeded() {
+    // снимок переписывается целиком, поэтому порог растёт вместе с коллекцией:
+    // на каждую запись журнала приходится O(1) амортизированной работы снимка
+    if (wal.recordCount() >= max(CHECKPOINT_RECORDS, map.getSize())) {
+        checkpoint();
+    }
+}
+
+bool Collection::buildIndex(const std::string &field, const std::string &type) {
+    if (field.empty() || field[0] == '$') return false;
+
+    // индекс строится без indexLock: таблицу сейчас меняет только этот писатель
+    if (type == "hash") {
+        if (indexes.count(field) != 0) return false;
+        HashIndex index(field, map.getFields());
+        map.forEach([&index](const string& id, const BinaryDocument& doc) { index.add(id, doc); });
+        lock_guard<RwLock> lock(indexLock);
+        indexes.emplace(field, std::move(index));
+        return true;
+    }
+    if (type == "range") {
+        if (rangeIndexes.count(field) != 0) return false;
+        RangeIndex index(field, map.getFields());
+        map.forEach([&index](const string& id, const BinaryDocument& doc) { index.add(id, doc); });
+        lock_guard<RwLock> lock(indexLock);
+        rangeIndexes.emplace(field, std::move(index));
+        return true;
+    }
+    return false;
+}
+
+bool Collection::createIndex(const std::string &field, const std::string &type) {
+    if (!buildIndex(field, type)) return false;
+    saveIndexList();
+    return true;
+}
+
+bool Collection::dropIndex(const std::string &field, const std::string &type) {
+    size_t removed;
+    {
+        lock_guard<RwLock> lock(indexLock);
+        removed = type == "range" ? rangeIndexes.erase(field) : indexes.erase(field);
+    }
+    if (removed == 0) return false;
+    saveIndexList();
+    return true;
+}
+
+const HashIndex* Collection::findIndex(const std::string &field) const {
+    const auto it = indexes.find(field);
+    return it == indexes.end() ? nullptr : &it->second;
+}
+
+const RangeIndex* Collection::findRangeIndex(const std::string &field) const {
+    const auto it = rangeIndexes.find(field);
+    return it == rangeIndexes.end() ? nullptr : &it->second;
+}
+
+void Collection::saveIndexList() const {
+    json fields = json::array();
+    for (const auto& [field, index] : indexes) {
+        fields.push_back({{"field", field}, {"type", "hash"}});
+    }
+    for (const auto& [field, index] : rangeIndexes) {
+        fields.push_back({{"field", field}, {"type", "range"}});
+    }
+
+    const string tmpPath = indexPath + ".tmp";
+    {
+        ofstream file(tmpPath, ios::trunc);
+        file << fields.dump();
+        if (!file) {
+            throw runtime_error("Не удалось сохранить список индексов " + indexPath);
+        }
+    }
+    syncFile(tmpPath);
+    filesystem::rename(tmpPath, indexPath);
+}
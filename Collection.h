@@ -0,0 +1,91 @@
+#ifndef PROVERKA_COLLECTION_H
+#define PROVERKA_COLLECTION_H
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "hashMap.h"
+#include "HashIndex.h"
+#include "RangeIndex.h"
+#include "RwLock.h"
+#include "WriteAheadLog.h"
+
+// Коллекция в памяти вместе со своим журналом. Все изменения проходят через
+// insert/erase, которые сначала ставят запись в журнал, а снимок на диске
+// обновляется только при контрольной точке. Подтверждать запись клиенту можно
+// только после waitDurable(commitTicket()).
+//
+// В таблице изменение видно сразу, ещё до fsync журнала. Поэтому коллекция
+// помнит, как отменить каждое неподтверждённое изменение: если пакет журнала
+// не запишется, waitDurable откатывает их в памяти, и ни читатели, ни
+// контрольная точка больше не видят записей, о которых клиент узнает, что они
+// не сохранены. Пока журнал не починен, insert и erase бросают LogWriteError.
+//
+// Вторичные индексы обновляются вместе с таблицей. На диске хранится только
+// список проиндексированных полей, сами индексы перестраиваются при загрузке.
+//
+// Писатели идут по одному под writeLock. Читатели замок записи не берут:
+// документы они читают из снимка таблицы (HashMap::forEachAt), а indexLock
+// держат разделяемо только пока выбирают кандидатов из индексов и закрепляют
+// версию. Писатель берёт indexLock монопольно лишь на время правки индексов
+// и публикации, поэтому версия снимка всегда совпадает с состоянием индексов.
+class Collection {
+private:
+    static constexpr size_t CHECKPOINT_RECORDS = 1000;
+
+    std::string snapshotPath;
+    std::string legacyPath;
+    std::string indexPath;
+    HashMap map;
+    WriteAheadLog wal;
+    std::map<std::string, HashIndex> indexes;
+    std::map<std::string, RangeIndex> rangeIndexes;
+    std::mutex writeLock;
+    mutable RwLock indexLock;
+
+    // изменение, ещё не подтверждённое журналом; previous — байты удалённого
+    // документа, пусто — это была вставка
+    struct Unconfirmed {
+        uint64_t ticket;
+        std::string id;
+        std::string previous;
+    };
+    std::deque<Unconfirmed> unconfirmed;
+
+    void forgetConfirmed();
+    void rollbackUnconfirmed();
+    void recoverLog();
+    void checkpointIfNeeded();
+    bool buildIndex(const std::string& field, const std::string& type);
+    void saveIndexList() const;
+public:
+    Collection(const std::string& database, const std::string& name);
+
+    [[nodiscard]] const HashMap& getMap() const { return map; }
+
+    // всё, что меняет коллекцию или её индексы, выполняется под этим замком
+    [[nodiscard]] std::mutex& getWriteLock() { return writeLock; }
+    [[nodiscard]] RwLock& getIndexLock() const { return indexLock; }
+
+    void load();
+    void insert(const std::string& id, const nlohmann::json& doc);
+    // удаляет документы одной публикацией: читатель видит либо все, либо ни одного
+    size_t erase(const MyVector<std::string>& ids);
+    void checkpoint();
+
+    // type: "hash" — равенство и $in, "range" — сравнения и диапазоны
+    bool createIndex(const std::string& field, const std::string& type);
+    bool dropIndex(const std::string& field, const std::string& type);
+    [[nodiscard]] const HashIndex* findIndex(const std::string& field) const;
+    [[nodiscard]] const RangeIndex* findRangeIndex(const std::string& field) const;
+
+    [[nodiscard]] uint64_t commitTicket() { return wal.currentTicket(); }
+    // бросает LogWriteError, если запись не попала на диск; к этому моменту
+    // она уже откачена. Вызывается без getWriteLock()
+    void waitDurable(uint64_t ticket);
+};
+
+
+#endif //PROVERKA_COLLECTION_H
@@ -1,144 +1,141 @@
 #include "Database.h"
 #include <iostream>
+#include <shared_mutex>
+#include <unordered_set>
 
 using namespace std;
 using namespace nlohmann;
 
 
 std::string Database::generateId() {
-    const auto now = chrono::duration_cast<chrono::milliseconds>(
-    chrono::system_clock::now().time_since_epoch()).count();
-    const uint32_t random_num = dist(gen);
-    return to_string(now) + "_" + to_string(random_num);
+    return IdGenerator::toString(IdGenerator::next());
 }
 
-bool Database::matchesCondition(const nlohmann::json &doc, const std::string &field, const nlohmann::json &condition) {
-    if (!doc.contains(field)) return false;
-
-    const json& value = doc[field];
-
-    if (!condition.is_object()) {
-        return value == condition;
+bool Database::collectCandidates(const Collection *coll, const Query &query, std::vector<std::string> &ids) {
+    string field;
+    vector<const json*> values;
+    const bool probed = query.findIndexProbe([coll](const string& name) {
+        return name == "_id" || coll->findIndex(name) != nullptr;
+    }, field, values);
+
+    if (!probed) {
+        Query::Range range;
+        const bool ranged = query.findRangeProbe([coll](const string& name) {
+            return coll->findRangeIndex(name) != nullptr;
+        }, field, range);
+        if (!ranged) return false;
+
+        coll->findRangeIndex(field)->forEachInRange(range.lower, range.lowerInclusive,
+                                                    range.upper, range.upperInclusive,
+                                                    [&ids](const string& id) { ids.push_back(id); });
+        return true;
     }
 
-    for (auto& [op, cond_val] : condition.items()) {
-        if (op == "$eq") {
-            if (value != cond_val) return false;
-        }
-        else if (op == "$gt") {
-            if (!(value.is_number() || value.is_string())) return false;
-            if (value <= cond_val) return false;
-        }
-        else if (op == "$lt") {
-            if (!(value.is_number() || value.is_string())) return false;
-            if (value >= cond_val) return false;
-        }
-        else if (op == "$in") {
-            if (!cond_val.is_array()) return false;
-            bool found = false;
-            for (const auto& item : cond_val) {
-                if (value == item) { found = true; break; }
-            }
-            if (!found) return false;
-        } else if (op == "$like") {
-            if (!value.is_string() || !cond_val.is_string()) return false;
-            const auto pattern = cond_val.get<string>();
-            const auto text = value.get<string>();
-
-            size_t pi = 0, ti = 0;
-            const size_t textLen = text.size();
-            const size_t patternLen = pattern.size();
-            int lastMath = -1, lastStar = -1;
-
-            while (ti < textLen) {
-                if (pi < patternLen && (text[ti] == pattern[pi] || pattern[pi] == '_')) {
-                    ti++;
-                    pi++;
-                } else if (pi < patternLen && pattern[pi] == '%') {
-                    lastStar = pi++;
-                    lastMath = ti;
-                } else if (lastStar != -1) {
-                    ti = ++lastMath;
-                    pi = lastStar + 1;
-                } else return false;
+    // разные ключи дают непересекающиеся множества id, повторы в $in пропускаем
+    unordered_set<string> seenKeys;
+    const HashIndex* index = field == "_id" ? nullptr : coll->findIndex(field);
+    for (const json* value : values) {
+        if (index == nullptr) {
+            if (value->is_string() && seenKeys.insert(value->get<string>()).second) {
+                ids.push_back(value->get<string>());
             }
-
-            while (pi < patternLen && pattern[pi] == '%') pi++;
-            return pi == patternLen;
+            continue;
+        }
+        const string key = HashIndex::keyOf(*value);
+        if (!seenKeys.insert(key).second) continue;
+        if (const auto* found = index->lookup(key)) {
+            ids.insert(ids.end(), found->begin(), found->end());
         }
     }
     return true;
 }
 
-bool Database::matchesQuery(const nlohmann::json &doc, const nlohmann::json &query) {
-    if (query.contains("$and")) {
-        for (const auto& cond : query["$and"]) {
-            if (!matchesQuery(doc, cond)) return false;
-        }
-        return true;
+template<typename F>
+void Database::forEachMatch(const Collection *coll, const Query &query, const uint64_t version,
+                            const bool indexed, const std::vector<std::string> &ids, F &&onMatch) {
+    const HashMap& map = coll->getMap();
+    if (!indexed) {
+        map.forEachAt(version, [&](const string& id, const BinaryDocument& doc) {
+            if (query.matches(doc)) onMatch(id, doc);
+        });
+        return;
     }
-
-
-    if (query.contains("$or")) {
-        for (const auto& cond : query["$or"]) {
-            if (matchesQuery(doc, cond)) return true;
-        }
-        return false;
+    for (const auto& id : ids) {
+        const BinaryDocument* doc = map.findByIdAt(id, version);
+        if (doc != nullptr && query.matches(*doc)) onMatch(id, *doc);
     }
-
-    // неявный AND
-    for (auto& [field, condition] : query.items()) {
-        if (field[0] == '$') continue;
-        if (!matchesCondition(doc, field, condition)) {
-            return false;
-        }
-    }
-    return true;
 }
 
-bool Database::insertDoc(HashMap* map, const std::string& jsonCommand) {
-    json doc = json::parse(jsonCommand);
+bool Database::insertDoc(Collection* coll, json&& doc) {
     string id = generateId();
     doc["_id"] = id;
-    map->hashMapInsert(id, doc);
+    coll->insert(id, doc);
     return true;
 }
 
-pair<int, json> Database::findDoc(const HashMap *map, const std::string &jsonCommand) {
-    json result = json::array();
-    const json query = json::parse(jsonCommand);
-    const auto allItems = map->items();
-    int count = 0;
+bool Database::insertDoc(Collection* coll, const json& doc) {
+    return insertDoc(coll, json(doc));
+}
 
-    for (const auto& [fst, snd] : allItems) {
-        if (matchesQuery(snd, query)) {
-            auto p = map->searchByKey(fst);
-            if (!p.first.empty() && !p.second.empty()) {
-                result.push_back(snd);
-                count+= 1;
-            }
-        }
-    }
-    return {count, result};
+bool Database::insertDoc(Collection* coll, const std::string& jsonCommand) {
+    return insertDoc(coll, json::parse(jsonCommand));
+}
+
+pair<int, json> Database::findDoc(const Collection *coll, const std::string &jsonCommand) {
+    return findDoc(coll, json::parse(jsonCommand));
 }
 
-pair<int, json> Database::deleteDoc(HashMap *map, const std::string &jsonCommand) {
+pair<int, json> Database::findDoc(const Collection *coll, const json &queryDoc) {
     json result = json::array();
-    const json query = json::parse(jsonCommand);
-    const auto allItems = map->items();
+    Query query(queryDoc);
     int count = 0;
 
-    for (const auto& [fst, snd] : allItems) {
-        if (matchesQuery(snd, query)) {
-            if (map->deleteById(fst)) {
-                result.push_back(snd);
-                count+= 1;
-            }
-        }
-    }
+    // под замком индексов только выбор кандидатов и версия снимка,
+    // сами документы читаются уже без него
+    vector<string> ids;
+    shared_lock<RwLock> planLock(coll->getIndexLock());
+    const Epoch::Reader reader(coll->getMap().getEpoch());
+    const bool indexed = collectCandidates(coll, query, ids);
+    planLock.unlock();
+
+    // имена полей переводятся в номера уже после того, как версия закреплена
+    const FieldDictionary& fields = coll->getMap().getFields();
+    query.bind(fields);
+    forEachMatch(coll, query, reader.version(), indexed, ids, [&](const string&, const BinaryDocument& doc) {
+        result.push_back(doc.toJson(fields));
+        count+= 1;
+    });
     return {count, result};
 }
 
+pair<int, json> Database::deleteDoc(Collection *coll, const std::string &jsonCommand) {
+    return deleteDoc(coll, json::parse(jsonCommand));
+}
 
+pair<int, json> Database::deleteDoc(Collection *coll, const json &queryDoc) {
+    json result = json::array();
+    Query query(queryDoc);
+    const FieldDictionary& fields = coll->getMap().getFields();
+    query.bind(fields);
+    MyVector<string> ids;
+
+    // писатель один, поэтому последнюю версию можно читать без снимка
+    vector<string> candidates;
+    const bool indexed = collectCandidates(coll, query, candidates);
+    forEachMatch(coll, query, coll->getMap().getEpoch().current(), indexed, candidates,
+                 [&](const string& id, const BinaryDocument& doc) {
+        ids.emplace_backV(id);
+        result.push_back(doc.toJson(fields));
+    });
+
+    const int count = static_cast<int>(coll->erase(ids));
+    return {count, result};
+}
 
+bool Database::createIndex(Collection *coll, const std::string &field, const std::string &type) {
+    return coll->createIndex(field, type);
+}
 
+bool Database::dropIndex(Collection *coll, const std::string &field, const std::string &type) {
+    return coll->dropIndex(field, type);
+}
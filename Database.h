@@ -2,25 +2,44 @@
 #define PROVERKA_DATABASE_H
 #include <chrono>
 #include <fstream>
-#include <random>
+#include <vector>
 #include <filesystem>
 
-#include "hashMap.h"
-
-static std::mt19937 gen(std::chrono::steady_clock::now().time_since_epoch().count());
-static std::uniform_int_distribution<uint32_t> dist(0, 1025);
+#include "Collection.h"
+#include "IdGenerator.h"
+#include "Query.h"
 
 class Database {
 private:
     static std::string generateId();
-    static bool matchesCondition(const nlohmann::json& doc, const std::string& field, const nlohmann::json& condition);
-    static bool matchesQuery(const nlohmann::json& doc, const nlohmann::json& query);
+
+    // Кандидаты по индексу: хеш-индекс (или сам HashMap для _id) либо
+    // упорядоченный индекс для диапазона. false — подходящего индекса нет,
+    // нужен полный обход. Читатель вызывает под getIndexLock().
+    static bool collectCandidates(const Collection* coll, const Query& query, std::vector<std::string>& ids);
+
+    // вызывает onMatch(id, doc) для подходящих документов, видимых в версии version
+    template<typename F>
+    static void forEachMatch(const Collection* coll, const Query& query, uint64_t version,
+                             bool indexed, const std::vector<std::string>& ids, F&& onMatch);
 public:
-    static bool insertDoc(HashMap* map, const std::string& jsonCommand);
+    // Запросы принимают уже разобранный JSON. Перегрузки со строкой
+    // разбирают её и вызывают их, они для тех, у кого на руках только текст.
+    static bool insertDoc(Collection* coll, nlohmann::json&& doc);
+    static bool insertDoc(Collection* coll, const nlohmann::json& doc);
+    static bool insertDoc(Collection* coll, const std::string& jsonCommand);
+
+    // не ждёт писателей: читает снимок коллекции на момент начала запроса
+    static std::pair<int, nlohmann::json> findDoc(const Collection *coll, const nlohmann::json &queryDoc);
+    static std::pair<int, nlohmann::json> findDoc(const Collection *coll, const std::string &jsonCommand);
+
+    // вызывается под coll->getWriteLock()
+    static std::pair<int, nlohmann::json>  deleteDoc(Collection* coll, const nlohmann::json& queryDoc);
+    static std::pair<int, nlohmann::json>  deleteDoc(Collection* coll, const std::string& jsonCommand);
 
-    static std::pair<int, nlohmann::json> findDoc(const HashMap *map, const std::string &jsonCommand);
+    static bool createIndex(Collection* coll, const std::string& field, const std::string& type);
 
-    static std::pair<int, nlohmann::json>  deleteDoc(HashMap* map, const std::string& jsonCommand);
+    static bool dropIndex(Collection* coll, const std::string& field, const std::string& type);
 
 };
 
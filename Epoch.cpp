@@ -0,0 +1,66 @@
+#include "Epoch.h"
+
+#include <thread>
+
+using namespace std;
+
+Epoch::Reader::Reader(const Epoch &epoch) : slot(nullptr), snapshot(epoch.current()) {
+    // свободная ячейка есть всегда, пока читателей не больше READER_SLOTS;
+    // иначе лишние ждут, пока кто-нибудь закончит
+    for (size_t i = 0; slot == nullptr; i = (i + 1) % READER_SLOTS) {
+        uint64_t expected = 0;
+        if (epoch.slots[i].version.compare_exchange_strong(expected, snapshot)) {
+            slot = &epoch.slots[i];
+        } else if (i == READER_SLOTS - 1) {
+            this_thread::yield();
+        }
+    }
+    // Писатель мог опубликовать новую версию и проверить ячейки до того, как
+    // он увидел нашу. Тогда перечитываем версию и закрепляем уже её.
+    while (true) {
+        atomic_thread_fence(memory_order_seq_cst);
+        const uint64_t latest = epoch.current();
+        if (latest == snapshot) break;
+        snapshot = latest;
+        slot->version.store(snapshot, memory_order_seq_cst);
+    }
+}
+
+Epoch::Reader::~Reader() {
+    slot->version.store(0, memory_order_release);
+}
+
+Epoch::~Epoch() {
+    for (const auto& item : retired) {
+        item.destroy(item.object);
+    }
+}
+
+void Epoch::publish() {
+    published.store(next(), memory_order_seq_cst);
+}
+
+uint64_t Epoch::oldestReader() const {
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t oldest = current();
+    for (const auto& slot : slots) {
+        const uint64_t version = slot.version.load(memory_order_acquire);
+        if (version != 0 && version < oldest) oldest = version;
+    }
+    return oldest;
+}
+
+void Epoch::retireObject(void *object, void (*destroy)(void *)) {
+    retired.push_back({current(), object, destroy});
+}
+
+void Epoch::reclaim() {
+    if (retired.empty()) return;
+    // Объект убран, когда опубликована версия item.version. Читатели с этой
+    // версией могли успеть его увидеть, читатели с более новой — уже нет.
+    const uint64_t oldest = oldestReader();
+    while (!retired.empty() && retired.front().version < oldest) {
+        retired.front().destroy(retired.front().object);
+        retired.pop_front();
+    }
+}
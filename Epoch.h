@@ -0,0 +1,83 @@
+#ifndef PROVERKA_EPOCH_H
+#define PROVERKA_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Версии коллекции и отложенное освобождение памяти для читателей без замков.
+//
+// Писатель (он всегда один) помечает изменения номером next() и делает их
+// видимыми разом через publish. Читатель на время чтения закрепляет
+// опубликованную версию (Reader) и видит ровно то, что было опубликовано
+// к этому моменту, сколько бы записей ни прошло параллельно.
+//
+// Убранное из структуры не удаляется сразу: retire откладывает delete до
+// тех пор, пока не закончат все читатели, которые могли это видеть.
+class Epoch {
+public:
+    // сколько читателей может одновременно держать снимок одной коллекции;
+    // читают потоки исполнителя, поэтому server.cpp не даёт их больше
+    static constexpr size_t READER_SLOTS = 64;
+private:
+
+    // закреплённая читателем версия, 0 — ячейка свободна
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> version{0};
+    };
+    struct Retired {
+        uint64_t version;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::atomic<uint64_t> published{1};
+    mutable Slot slots[READER_SLOTS];
+    std::deque<Retired> retired;    // только писатель
+
+    void retireObject(void* object, void (*destroy)(void*));
+public:
+    // Закреплённый снимок. Пока он жив, всё, что видно в version(),
+    // не будет освобождено.
+    class Reader {
+    private:
+        Slot* slot;
+        uint64_t snapshot;
+    public:
+        explicit Reader(const Epoch& epoch);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        [[nodiscard]] uint64_t version() const { return snapshot; }
+    };
+
+    Epoch() = default;
+    ~Epoch();
+
+    Epoch(const Epoch&) = delete;
+    Epoch& operator=(const Epoch&) = delete;
+
+    [[nodiscard]] uint64_t current() const { return published.load(std::memory_order_acquire); }
+    [[nodiscard]] uint64_t next() const { return current() + 1; }
+    void publish();
+
+    // самая старая версия, которую ещё может видеть какой-нибудь читатель
+    [[nodiscard]] uint64_t oldestReader() const;
+
+    template<typename T>
+    void retire(T* object) {
+        retireObject(object, [](void* p) { delete static_cast<T*>(p); });
+    }
+    template<typename T>
+    void retireArray(T* array) {
+        retireObject(array, [](void* p) { delete[] static_cast<T*>(p); });
+    }
+    // освобождает всё, чего уже не видит ни один читатель
+    void reclaim();
+};
+
+
+#endif //PROVERKA_EPOCH_H
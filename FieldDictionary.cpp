@@ -0,0 +1,43 @@
+#include "FieldDictionary.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+
+using namespace std;
+
+FieldDictionary::FieldDictionary() : chunks{}, count(0) {}
+
+FieldDictionary::~FieldDictionary() {
+    for (auto& chunk : chunks) {
+        delete[] chunk.load(memory_order_relaxed);
+    }
+}
+
+uint32_t FieldDictionary::intern(const std::string_view name) {
+    // словарь меняет только этот поток, поэтому читать ids можно без замка
+    if (const auto it = ids.find(name); it != ids.end()) return it->second;
+
+    const uint32_t id = count.load(memory_order_relaxed);
+    const size_t chunk = id >> CHUNK_BITS;
+    if (chunk >= MAX_CHUNKS) throw runtime_error("Слишком много разных имён полей в коллекции");
+    string* names = chunks[chunk].load(memory_order_relaxed);
+    if (names == nullptr) {
+        names = new string[CHUNK_SIZE];
+        chunks[chunk].store(names, memory_order_release);
+    }
+    string& stored = names[id & (CHUNK_SIZE - 1)];
+    stored = name;
+    {
+        lock_guard<RwLock> lock(idsLock);
+        ids.emplace(stored, id);
+    }
+    count.store(id + 1, memory_order_release);
+    return id;
+}
+
+uint32_t FieldDictionary::find(const std::string_view name) const {
+    shared_lock<RwLock> lock(idsLock);
+    const auto it = ids.find(name);
+    return it == ids.end() ? NO_FIELD : it->second;
+}
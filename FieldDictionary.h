@@ -0,0 +1,56 @@
+#ifndef PROVERKA_FIELDDICTIONARY_H
+#define PROVERKA_FIELDDICTIONARY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "RwLock.h"
+
+// Словарь имён полей одной коллекции. Документы (BinaryDocument) хранят
+// вместо имён их номера, поэтому "_id", "name" и прочие общие ключи лежат
+// в памяти по одному разу, а поиск поля сравнивает числа.
+//
+// Номера не переиспользуются и не удаляются: коллекция, у которой имена
+// полей — это данные (например, id пользователей в ключах), растит словарь
+// до MAX_CHUNKS * CHUNK_SIZE (около миллиона) имён, после чего intern
+// бросает исключение и документы с новыми именами не вставляются.
+//
+// Добавляет имена только писатель коллекции. name() читается без замков:
+// номер попадает в документ раньше, чем документ публикуется, а к этому
+// времени имя уже записано. find() для читателей идёт под разделяемым замком.
+class FieldDictionary {
+private:
+    static constexpr size_t CHUNK_BITS = 10;
+    static constexpr size_t CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = 1024;
+
+    // имена лежат кусками по CHUNK_SIZE и не переезжают
+    std::atomic<std::string*> chunks[MAX_CHUNKS];
+    std::atomic<uint32_t> count;
+    std::unordered_map<std::string_view, uint32_t> ids;  // ключи указывают в chunks
+    mutable RwLock idsLock;
+public:
+    static constexpr uint32_t NO_FIELD = UINT32_MAX;
+
+    FieldDictionary();
+    ~FieldDictionary();
+
+    FieldDictionary(const FieldDictionary&) = delete;
+    FieldDictionary& operator=(const FieldDictionary&) = delete;
+
+    // номер имени, новое имя получает следующий номер; только писатель
+    uint32_t intern(std::string_view name);
+    // NO_FIELD, если такого имени ещё нет
+    [[nodiscard]] uint32_t find(std::string_view name) const;
+    [[nodiscard]] const std::string& name(uint32_t id) const {
+        return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+    }
+    [[nodiscard]] uint32_t size() const { return count.load(std::memory_order_acquire); }
+};
+
+
+#endif //PROVERKA_FIELDDICTIONARY_H
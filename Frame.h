@@ -0,0 +1,41 @@
+#ifndef PROVERKA_FRAME_H
+#define PROVERKA_FRAME_H
+
+#include <cstdint>
+#include <string>
+
+// Кадр протокола: 4 байта длины (big-endian), затем JSON этой длины.
+// Запрос не длиннее MAX_REQUEST_FRAME, поэтому первый байт его заголовка
+// меньше 0x08 и не совпадает ни с одним символом JSON-текста; по нему
+// сервер отличает кадры от старых клиентов, присылающих голый JSON.
+const size_t FRAME_HEADER_SIZE = 4;
+const uint32_t MAX_REQUEST_FRAME = 64u * 1024 * 1024;
+
+inline bool looksFramed(const char firstByte) {
+    return static_cast<unsigned char>(firstByte) < 0x08;
+}
+
+inline uint32_t readFrameLength(const char* header) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(header);
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+inline void appendFrame(std::string& out, const std::string& payload) {
+    const auto length = static_cast<uint32_t>(payload.size());
+    const char header[FRAME_HEADER_SIZE] = {
+        static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+        static_cast<char>(length >> 8), static_cast<char>(length)
+    };
+    out.append(header, FRAME_HEADER_SIZE);
+    out.append(payload);
+}
+
+inline std::string encodeFrame(const std::string& payload) {
+    std::string frame;
+    frame.reserve(FRAME_HEADER_SIZE + payload.size());
+    appendFrame(frame, payload);
+    return frame;
+}
+
+
+#endif //PROVERKA_FRAME_H
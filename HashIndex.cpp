@@ -0,0 +1,43 @@
+#include "HashIndex.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+using namespace nlohmann;
+
+HashIndex::HashIndex(std::string fieldName, FieldDictionary &dictionary) :
+                        field(std::move(fieldName)), fieldId(dictionary.intern(field)), fields(&dictionary) {}
+
+string HashIndex::keyOf(const nlohmann::json &value) {
+    if (value.is_number_float()) {
+        const double number = value.get<double>();
+        // целые значения с плавающей точкой совпадают с целыми числами
+        if (std::floor(number) == number && std::fabs(number) < 9.2e18) {
+            return to_string(static_cast<int64_t>(number));
+        }
+    }
+    return value.dump();
+}
+
+void HashIndex::add(const std::string &id, const BinaryDocument &doc) {
+    const auto value = doc.find(fieldId);
+    if (!value) return;
+    entries[keyOf(value.toJson(*fields))].insert(id);
+}
+
+void HashIndex::remove(const std::string &id, const BinaryDocument &doc) {
+    const auto value = doc.find(fieldId);
+    if (!value) return;
+
+    const auto entry = entries.find(keyOf(value.toJson(*fields)));
+    if (entry == entries.end()) return;
+    entry->second.erase(id);
+    if (entry->second.empty()) entries.erase(entry);
+}
+
+const unordered_set<string>* HashIndex::lookup(const std::string &key) const {
+    const auto it = entries.find(key);
+    return it == entries.end() ? nullptr : &it->second;
+}
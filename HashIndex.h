@@ -0,0 +1,35 @@
+#ifndef PROVERKA_HASHINDEX_H
+#define PROVERKA_HASHINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "BinaryDocument.h"
+#include "json.hpp"
+
+// Вторичный индекс по одному полю: значение поля -> множество _id документов.
+// Значения сравниваются так же, как json ==, поэтому 5, 5u и 5.0 дают один ключ.
+class HashIndex {
+private:
+    std::string field;
+    uint32_t fieldId;
+    const FieldDictionary* fields;
+    std::unordered_map<std::string, std::unordered_set<std::string>> entries;
+public:
+    // имя поля заносится в словарь коллекции, даже если его ещё нет в документах
+    HashIndex(std::string fieldName, FieldDictionary& dictionary);
+
+    [[nodiscard]] const std::string& getField() const { return field; }
+
+    // ключ индекса для значения; для массивов и объектов — их dump()
+    [[nodiscard]] static std::string keyOf(const nlohmann::json& value);
+
+    void add(const std::string& id, const BinaryDocument& doc);
+    void remove(const std::string& id, const BinaryDocument& doc);
+    [[nodiscard]] const std::unordered_set<std::string>* lookup(const std::string& key) const;
+};
+
+
+#endif //PROVERKA_HASHINDEX_H
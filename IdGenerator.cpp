@@ -0,0 +1,89 @@
+#include "IdGenerator.h"
+
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+    // base32 Крокфорда: символы идут по возрастанию ASCII
+    const char ALPHABET[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+}
+
+atomic<uint32_t> IdGenerator::node{0};
+atomic<uint64_t> IdGenerator::freeSlots{~(uint64_t{1} << SHARED_SLOT)};
+atomic<uint64_t> IdGenerator::slotLast[SLOTS] = {};
+atomic<uint64_t> IdGenerator::sharedLast{0};
+
+struct IdGenerator::ThreadState {
+    uint32_t slot = SLOTS;  // SLOTS — ячейка ещё не занята
+    uint64_t last = 0;
+
+    void claim() {
+        uint64_t mask = freeSlots.load(memory_order_relaxed);
+        while (mask != 0) {
+            const auto lowest = static_cast<uint32_t>(__builtin_ctzll(mask));
+            if (freeSlots.compare_exchange_weak(mask, mask & ~(uint64_t{1} << lowest),
+                                                memory_order_acquire, memory_order_relaxed)) {
+                slot = lowest;
+                last = slotLast[lowest].load(memory_order_relaxed);
+                return;
+            }
+        }
+        slot = SHARED_SLOT;
+    }
+
+    ~ThreadState() {
+        if (slot >= SHARED_SLOT) return;
+        slotLast[slot].store(last, memory_order_relaxed);
+        freeSlots.fetch_or(uint64_t{1} << slot, memory_order_release);
+    }
+};
+
+void IdGenerator::setNode(const uint32_t nodeId) {
+    if (nodeId > MAX_NODE) {
+        throw runtime_error("Номер узла должен быть от 0 до " + to_string(MAX_NODE));
+    }
+    node.store(nodeId, memory_order_relaxed);
+}
+
+uint64_t IdGenerator::advance(const uint64_t last) {
+    const auto now = static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+    const uint64_t candidate = (now > EPOCH_MS ? now - EPOCH_MS : 0) << SEQUENCE_BITS;
+    // переполнение последовательности само переходит в следующую миллисекунду
+    return candidate > last ? candidate : last + 1;
+}
+
+uint64_t IdGenerator::compose(const uint64_t state, const uint32_t slot) {
+    const uint64_t millis = state >> SEQUENCE_BITS;
+    const uint64_t sequence = state & ((uint64_t{1} << SEQUENCE_BITS) - 1);
+    return millis << (NODE_BITS + SLOT_BITS + SEQUENCE_BITS)
+           | static_cast<uint64_t>(node.load(memory_order_relaxed)) << (SLOT_BITS + SEQUENCE_BITS)
+           | static_cast<uint64_t>(slot) << SEQUENCE_BITS
+           | sequence;
+}
+
+uint64_t IdGenerator::next() {
+    thread_local ThreadState state;
+    if (state.slot == SLOTS) state.claim();
+
+    if (state.slot == SHARED_SLOT) {
+        uint64_t last = sharedLast.load(memory_order_relaxed);
+        uint64_t following;
+        do {
+            following = advance(last);
+        } while (!sharedLast.compare_exchange_weak(last, following, memory_order_relaxed));
+        return compose(following, SHARED_SLOT);
+    }
+    state.last = advance(state.last);
+    return compose(state.last, state.slot);
+}
+
+std::string IdGenerator::toString(uint64_t id) {
+    string text(TEXT_LENGTH, '0');
+    for (size_t i = TEXT_LENGTH; i-- > 0; id >>= 5) {
+        text[i] = ALPHABET[id & 31];
+    }
+    return text;
+}
@@ -0,0 +1,52 @@
+#ifndef PROVERKA_IDGENERATOR_H
+#define PROVERKA_IDGENERATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Генератор _id документов без блокировок и без общих счётчиков.
+//
+// id — 64 бита: 41 бит миллисекунд от EPOCH_MS, 10 бит номера узла
+// (--node-id), 6 бит ячейки потока и 7 бит последовательности. Каждый поток
+// при первом вызове занимает свою ячейку и дальше считает сам; когда
+// последовательность в одной миллисекунде кончается или часы идут назад,
+// поток берёт следующую миллисекунду после своей последней, так что его id
+// только растут. Ячейка освобождается при завершении потока вместе с
+// последним выданным значением, и новый владелец продолжает с него.
+// Если все ячейки заняты, поток берёт общую ячейку через CAS.
+//
+// Текстовый вид — 13 символов base32 Крокфорда: строки сравниваются
+// так же, как числа, и помещаются в std::string без выделения памяти.
+class IdGenerator {
+private:
+    static constexpr uint64_t EPOCH_MS = 1704067200000;  // 2024-01-01 UTC
+    static constexpr int SEQUENCE_BITS = 7;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int NODE_BITS = 10;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t SHARED_SLOT = SLOTS - 1;
+
+    struct ThreadState;
+
+    static std::atomic<uint32_t> node;
+    static std::atomic<uint64_t> freeSlots;            // бит i — ячейка i свободна
+    static std::atomic<uint64_t> slotLast[SLOTS];      // последнее значение ушедшего владельца
+    static std::atomic<uint64_t> sharedLast;
+
+    // (миллисекунда << SEQUENCE_BITS) | последовательность
+    [[nodiscard]] static uint64_t advance(uint64_t last);
+    [[nodiscard]] static uint64_t compose(uint64_t state, uint32_t slot);
+public:
+    static constexpr uint32_t MAX_NODE = (1u << NODE_BITS) - 1;
+    static constexpr size_t TEXT_LENGTH = 13;
+
+    // задаётся до первого next(); разные узлы не пересекаются по id
+    static void setNode(uint32_t nodeId);
+
+    [[nodiscard]] static uint64_t next();
+    [[nodiscard]] static std::string toString(uint64_t id);
+};
+
+
+#endif //PROVERKA_IDGENERATOR_H
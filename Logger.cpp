@@ -0,0 +1,165 @@
+#include "Logger.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+    const auto IDLE_WAIT = chrono::milliseconds(50);
+}
+
+unique_ptr<Logger::Slot[]> Logger::slots;
+atomic<size_t> Logger::tail{0};
+size_t Logger::head = 0;
+
+atomic<int> Logger::minLevel{static_cast<int>(LogLevel::Info)};
+atomic<uint32_t> Logger::sampleEvery{1};
+atomic<uint64_t> Logger::sampleCounter{0};
+atomic<uint64_t> Logger::dropped{0};
+
+thread Logger::writer;
+mutex Logger::wakeMutex;
+condition_variable Logger::wake;
+atomic<bool> Logger::writerSleeping{false};
+atomic<bool> Logger::stopping{false};
+
+void Logger::start() {
+    if (writer.joinable()) {
+        return;
+    }
+    slots = make_unique<Slot[]>(CAPACITY);
+    for (size_t i = 0; i < CAPACITY; i++) {
+        slots[i].sequence.store(i, memory_order_relaxed);
+    }
+    stopping = false;
+    writer = thread(&Logger::writerLoop);
+}
+
+void Logger::stop() {
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+}
+
+void Logger::setLevel(const LogLevel level) {
+    minLevel.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+void Logger::setRequestSampling(const uint32_t every) {
+    sampleEvery.store(every, memory_order_relaxed);
+}
+
+bool Logger::parseLevel(const string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::Debug;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "warn") level = LogLevel::Warn;
+    else if (name == "error") level = LogLevel::Error;
+    else if (name == "off") level = LogLevel::Off;
+    else return false;
+    return true;
+}
+
+bool Logger::sampleRequest() {
+    const uint32_t every = sampleEvery.load(memory_order_relaxed);
+    if (every <= 1) {
+        return every == 1;
+    }
+    return sampleCounter.fetch_add(1, memory_order_relaxed) % every == 0;
+}
+
+void Logger::log(const LogLevel level, string text) {
+    if (!enabled(level)) {
+        return;
+    }
+    if (!slots) {
+        // фоновый поток не запущен: пишем сразу, как раньше
+        text.push_back('\n');
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+        return;
+    }
+
+    size_t position = tail.load(memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots[position & (CAPACITY - 1)];
+        const size_t sequence = slot->sequence.load(memory_order_acquire);
+        const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // ячейку ещё не освободил фоновый поток: буфер полон
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        } else {
+            position = tail.load(memory_order_relaxed);
+        }
+    }
+    slot->text = std::move(text);
+    slot->sequence.store(position + 1, memory_order_release);
+
+    if (writerSleeping.load(memory_order_acquire)) {
+        wake.notify_one();
+    }
+}
+
+// Забирает из буфера всё, что уже опубликовано, в одну строку
+bool Logger::drain(string& batch) {
+    bool any = false;
+    while (true) {
+        Slot& slot = slots[head & (CAPACITY - 1)];
+        if (slot.sequence.load(memory_order_acquire) != head + 1) {
+            break;
+        }
+        batch += slot.text;
+        batch.push_back('\n');
+        slot.text.clear();
+        slot.sequence.store(head + CAPACITY, memory_order_release);
+        head++;
+        any = true;
+    }
+    return any;
+}
+
+void Logger::writerLoop() {
+    string batch;
+    while (true) {
+        batch.clear();
+        const bool any = drain(batch);
+
+        const uint64_t lost = dropped.exchange(0, memory_order_relaxed);
+        if (lost > 0) {
+            batch += "[Журнал] буфер переполнен, пропущено записей: " + to_string(lost) + "\n";
+        }
+        if (!batch.empty()) {
+            fwrite(batch.data(), 1, batch.size(), stdout);
+            fflush(stdout);
+        }
+        if (any) {
+            continue;
+        }
+
+        unique_lock<mutex> lock(wakeMutex);
+        if (stopping) {
+            batch.clear();
+            drain(batch);
+            fwrite(batch.data(), 1, batch.size(), stdout);
+            fflush(stdout);
+            return;
+        }
+        // ожидание с таймаутом: производители будят без замка и могут
+        // разминуться с засыпанием, тогда запись подождёт IDLE_WAIT
+        writerSleeping.store(true, memory_order_release);
+        wake.wait_for(lock, IDLE_WAIT);
+        writerSleeping.store(false, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef PROVERKA_LOGGER_H
+#define PROVERKA_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum class LogLevel { Debug, Info, Warn, Error, Off };
+
+// Асинхронный журнал сервера. Потоки запросов кладут готовую строку в
+// кольцевой буфер без блокировок (очередь Вьюкова: место занимается через
+// CAS на хвосте, запись публикуется номером в ячейке) и сразу возвращаются;
+// в stdout пишет один фоновый поток, пачками. Если буфер полон, запись
+// отбрасывается и учитывается: журнал не должен тормозить запросы.
+//
+// Уровень и выборка журнала запросов меняются на ходу: setLevel и
+// setRequestSampling (1 — каждый запрос, N — каждый N-й, 0 — ни одного).
+class Logger {
+private:
+    static constexpr size_t CAPACITY = 8192; // степень двойки
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        std::string text;
+    };
+
+    static std::unique_ptr<Slot[]> slots;
+    static std::atomic<size_t> tail;
+    static size_t head;                      // только фоновый поток
+
+    static std::atomic<int> minLevel;
+    static std::atomic<uint32_t> sampleEvery;
+    static std::atomic<uint64_t> sampleCounter;
+    static std::atomic<uint64_t> dropped;
+
+    static std::thread writer;
+    static std::mutex wakeMutex;
+    static std::condition_variable wake;
+    static std::atomic<bool> writerSleeping;
+    static std::atomic<bool> stopping;
+
+    static void writerLoop();
+    static bool drain(std::string& batch);
+public:
+    static void start();
+    static void stop();
+
+    static void setLevel(LogLevel level);
+    static void setRequestSampling(uint32_t every);
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+    // проверка до форматирования строки, чтобы не тратить время впустую
+    [[nodiscard]] static bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+    // true, если этот запрос попадает в выборку
+    [[nodiscard]] static bool sampleRequest();
+
+    static void log(LogLevel level, std::string text);
+};
+
+
+#endif //PROVERKA_LOGGER_H
@@ -0,0 +1,299 @@
+#include "Query.h"
+
+using namespace std;
+using namespace nlohmann;
+
+Query::Query(const nlohmann::json &query) : root(compileNode(query)) {}
+
+Query::Node Query::compileNode(const nlohmann::json &query) {
+    Node node;
+    if (!query.is_object()) return node;
+
+    // как и раньше, $and и $or перекрывают остальные поля на своём уровне
+    if (const auto it = query.find("$and"); it != query.end()) {
+        node.kind = Node::Kind::And;
+        for (const auto& cond : *it) {
+            node.children.push_back(compileNode(cond));
+        }
+        return node;
+    }
+    if (const auto it = query.find("$or"); it != query.end()) {
+        node.kind = Node::Kind::Or;
+        for (const auto& cond : *it) {
+            node.children.push_back(compileNode(cond));
+        }
+        return node;
+    }
+
+    // неявный AND
+    for (const auto& [field, condition] : query.items()) {
+        if (field[0] == '$') continue;
+        node.fields.push_back(compileField(field, condition));
+    }
+    return node;
+}
+
+Query::FieldTest Query::compileField(const std::string &field, const nlohmann::json &condition) {
+    FieldTest test;
+    test.field = field;
+
+    if (!condition.is_object()) {
+        test.conditions.push_back({Op::Eq, condition});
+        return test;
+    }
+
+    for (const auto& [op, cond_val] : condition.items()) {
+        if (op == "$eq") {
+            test.conditions.push_back({Op::Eq, cond_val});
+        } else if (op == "$gt") {
+            test.conditions.push_back({Op::Gt, cond_val});
+        } else if (op == "$gte") {
+            test.conditions.push_back({Op::Gte, cond_val});
+        } else if (op == "$lt") {
+            test.conditions.push_back({Op::Lt, cond_val});
+        } else if (op == "$lte") {
+            test.conditions.push_back({Op::Lte, cond_val});
+        } else if (op == "$in") {
+            test.conditions.push_back({cond_val.is_array() ? Op::In : Op::Never, cond_val});
+        } else if (op == "$like") {
+            test.conditions.push_back(compileLike(cond_val));
+        }
+    }
+    return test;
+}
+
+Query::Condition Query::compileLike(const nlohmann::json &pattern) {
+    if (!pattern.is_string()) return {Op::Never, nullptr};
+
+    Condition cond{Op::Like, nullptr};
+    cond.pattern = pattern.get<string>();
+
+    const size_t wildcard = cond.pattern.find_first_of("%_");
+    if (wildcard == string::npos) {
+        cond.likeKind = LikeKind::Exact;
+    } else if (wildcard == cond.pattern.size() - 1 && cond.pattern.back() == '%') {
+        cond.likeKind = LikeKind::Prefix;
+        cond.pattern.pop_back();
+    }
+    return cond;
+}
+
+void Query::bind(const FieldDictionary &dictionary) {
+    bindNode(root, dictionary);
+    fields = &dictionary;
+}
+
+void Query::bindNode(Node &node, const FieldDictionary &dictionary) {
+    for (auto& child : node.children) bindNode(child, dictionary);
+    for (auto& test : node.fields) test.fieldId = dictionary.find(test.field);
+}
+
+bool Query::matches(const BinaryDocument &doc) const {
+    return matchesNode(root, doc, *fields);
+}
+
+bool Query::findIndexProbe(const std::function<bool(const std::string&)> &hasIndex,
+                           std::string &field, std::vector<const nlohmann::json*> &values) const {
+    return probeNode(root, hasIndex, field, values);
+}
+
+bool Query::probeNode(const Node &node, const std::function<bool(const std::string&)> &hasIndex,
+                      std::string &field, std::vector<const nlohmann::json*> &values) {
+    if (node.kind == Node::Kind::And) {
+        for (const auto& child : node.children) {
+            if (probeNode(child, hasIndex, field, values)) return true;
+        }
+        return false;
+    }
+    // для $or пришлось бы объединять несколько индексов, такой запрос сканируется
+    if (node.kind == Node::Kind::Or) return false;
+
+    for (const auto& test : node.fields) {
+        if (!hasIndex(test.field)) continue;
+        for (const auto& cond : test.conditions) {
+            // по индексу ищутся только скалярные значения: для массивов и объектов
+            // ключ индекса не совпадает с json == при вложенных числах
+            if (cond.op == Op::Eq && cond.value.is_primitive()) {
+                field = test.field;
+                values = {&cond.value};
+                return true;
+            }
+            if (cond.op == Op::In) {
+                bool scalar = true;
+                for (const auto& item : cond.value) scalar = scalar && item.is_primitive();
+                if (!scalar) continue;
+                field = test.field;
+                values.clear();
+                for (const auto& item : cond.value) values.push_back(&item);
+                return true;
+            }
+            if (cond.op == Op::Never) {
+                field = test.field;
+                values.clear();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Query::findRangeProbe(const std::function<bool(const std::string&)> &hasIndex,
+                           std::string &field, Range &range) const {
+    return rangeNode(root, hasIndex, field, range);
+}
+
+bool Query::rangeNode(const Node &node, const std::function<bool(const std::string&)> &hasIndex,
+                      std::string &field, Range &range) {
+    if (node.kind == Node::Kind::And) {
+        for (const auto& child : node.children) {
+            if (rangeNode(child, hasIndex, field, range)) return true;
+        }
+        return false;
+    }
+    if (node.kind == Node::Kind::Or) return false;
+
+    for (const auto& test : node.fields) {
+        if (!hasIndex(test.field)) continue;
+
+        Range bounds;
+        // из нескольких нижних границ берём наибольшую, при равенстве — строгую
+        auto tightenLower = [&bounds](const json* value, bool inclusive) {
+            if (bounds.lower == nullptr || *bounds.lower < *value ||
+                (!(*value < *bounds.lower) && !inclusive)) {
+                bounds.lower = value;
+                bounds.lowerInclusive = inclusive;
+            }
+        };
+        auto tightenUpper = [&bounds](const json* value, bool inclusive) {
+            if (bounds.upper == nullptr || *value < *bounds.upper ||
+                (!(*bounds.upper < *value) && !inclusive)) {
+                bounds.upper = value;
+                bounds.upperInclusive = inclusive;
+            }
+        };
+
+        for (const auto& cond : test.conditions) {
+            switch (cond.op) {
+                case Op::Gt: tightenLower(&cond.value, false); break;
+                case Op::Gte: tightenLower(&cond.value, true); break;
+                case Op::Lt: tightenUpper(&cond.value, false); break;
+                case Op::Lte: tightenUpper(&cond.value, true); break;
+                case Op::Eq:
+                    if (cond.value.is_number() || cond.value.is_string()) {
+                        tightenLower(&cond.value, true);
+                        tightenUpper(&cond.value, true);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (bounds.lower != nullptr || bounds.upper != nullptr) {
+            field = test.field;
+            range = bounds;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Query::matchesNode(const Node &node, const BinaryDocument &doc, const FieldDictionary &dictionary) {
+    switch (node.kind) {
+        case Node::Kind::And:
+            for (const auto& child : node.children) {
+                if (!matchesNode(child, doc, dictionary)) return false;
+            }
+            return true;
+        case Node::Kind::Or:
+            for (const auto& child : node.children) {
+                if (matchesNode(child, doc, dictionary)) return true;
+            }
+            return false;
+        case Node::Kind::Fields:
+            for (const auto& test : node.fields) {
+                if (!matchesField(test, doc, dictionary)) return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+bool Query::matchesField(const FieldTest &test, const BinaryDocument &doc, const FieldDictionary &dictionary) {
+    const auto value = doc.find(test.fieldId);
+    if (!value) return false;
+
+    for (const auto& cond : test.conditions) {
+        if (!matchesCondition(cond, value, dictionary)) return false;
+    }
+    return true;
+}
+
+// Строка со строкой сравнивается прямо в буфере документа. Остальное — через
+// json, чтобы числа разных типов и значения разных типов сравнивались так же,
+// как у nlohmann::json; для чисел это не выделяет память.
+template<typename Compare>
+static bool compareValue(const BinaryDocument::Value &value, const json &other,
+                         const FieldDictionary &dictionary, Compare compare) {
+    if (value.isString() && other.is_string()) {
+        return compare(value.string(), string_view(other.get_ref<const string&>()));
+    }
+    return compare(value.toJson(dictionary), other);
+}
+
+bool Query::matchesCondition(const Condition &cond, const BinaryDocument::Value &value,
+                             const FieldDictionary &dictionary) {
+    switch (cond.op) {
+        case Op::Eq:
+            return compareValue(value, cond.value, dictionary, [](const auto& a, const auto& b) { return a == b; });
+        case Op::Gt:
+            if (!(value.isNumber() || value.isString())) return false;
+            return compareValue(value, cond.value, dictionary, [](const auto& a, const auto& b) { return !(a <= b); });
+        case Op::Gte:
+            if (!(value.isNumber() || value.isString())) return false;
+            return compareValue(value, cond.value, dictionary, [](const auto& a, const auto& b) { return !(a < b); });
+        case Op::Lt:
+            if (!(value.isNumber() || value.isString())) return false;
+            return compareValue(value, cond.value, dictionary, [](const auto& a, const auto& b) { return !(a >= b); });
+        case Op::Lte:
+            if (!(value.isNumber() || value.isString())) return false;
+            return compareValue(value, cond.value, dictionary, [](const auto& a, const auto& b) { return !(a > b); });
+        case Op::In:
+            for (const auto& item : cond.value) {
+                if (compareValue(value, item, dictionary, [](const auto& a, const auto& b) { return a == b; })) return true;
+            }
+            return false;
+        case Op::Like:
+            if (!value.isString()) return false;
+            return matchesLike(cond, value.string());
+        case Op::Never:
+            return false;
+    }
+    return false;
+}
+
+bool Query::matchesLike(const Condition &cond, const std::string_view text) {
+    const string& pattern = cond.pattern;
+    if (cond.likeKind == LikeKind::Exact) return text == pattern;
+    if (cond.likeKind == LikeKind::Prefix) return text.compare(0, pattern.size(), pattern) == 0;
+
+    size_t pi = 0, ti = 0;
+    const size_t textLen = text.size();
+    const size_t patternLen = pattern.size();
+    long lastMatch = -1, lastStar = -1;
+
+    while (ti < textLen) {
+        if (pi < patternLen && (text[ti] == pattern[pi] || pattern[pi] == '_')) {
+            ti++;
+            pi++;
+        } else if (pi < patternLen && pattern[pi] == '%') {
+            lastStar = static_cast<long>(pi++);
+            lastMatch = static_cast<long>(ti);
+        } else if (lastStar != -1) {
+            ti = ++lastMatch;
+            pi = lastStar + 1;
+        } else return false;
+    }
+
+    while (pi < patternLen && pattern[pi] == '%') pi++;
+    return pi == patternLen;
+}
@@ -0,0 +1,96 @@
+#ifndef PROVERKA_QUERY_H
+#define PROVERKA_QUERY_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "BinaryDocument.h"
+#include "json.hpp"
+
+// Скомпилированный запрос. JSON запроса разбирается один раз в дерево
+// предикатов с уже распознанными операторами и подготовленными шаблонами
+// $like, после чего matches() проверяет документы без повторного разбора.
+//
+// Документы хранят номера полей, а не имена, поэтому перед matches() запрос
+// привязывается к словарю коллекции (bind). Читатель делает это уже после
+// того, как закрепил версию: все поля документов этой версии к тому времени
+// есть в словаре.
+class Query {
+private:
+    enum class Op { Eq, Gt, Gte, Lt, Lte, In, Like, Never };
+    enum class LikeKind { Exact, Prefix, Generic };
+
+    struct Condition {
+        Op op;
+        nlohmann::json value;
+        std::string pattern;
+        LikeKind likeKind = LikeKind::Generic;
+
+        Condition(const Op operation, nlohmann::json operand) : op(operation), value(std::move(operand)) {}
+    };
+
+    struct FieldTest {
+        std::string field;
+        uint32_t fieldId = FieldDictionary::NO_FIELD;  // после bind; NO_FIELD — поля нет ни в одном документе
+        std::vector<Condition> conditions;
+    };
+
+    struct Node {
+        enum class Kind { And, Or, Fields } kind = Kind::Fields;
+        std::vector<Node> children;
+        std::vector<FieldTest> fields;
+    };
+
+    Node root;
+    const FieldDictionary* fields = nullptr;
+
+    static bool probeNode(const Node& node, const std::function<bool(const std::string&)>& hasIndex,
+                          std::string& field, std::vector<const nlohmann::json*>& values);
+
+    static Node compileNode(const nlohmann::json& query);
+    static FieldTest compileField(const std::string& field, const nlohmann::json& condition);
+    static Condition compileLike(const nlohmann::json& pattern);
+    static void bindNode(Node& node, const FieldDictionary& dictionary);
+
+    static bool matchesNode(const Node& node, const BinaryDocument& doc, const FieldDictionary& dictionary);
+    static bool matchesField(const FieldTest& test, const BinaryDocument& doc, const FieldDictionary& dictionary);
+    static bool matchesCondition(const Condition& cond, const BinaryDocument::Value& value,
+                                 const FieldDictionary& dictionary);
+    static bool matchesLike(const Condition& cond, std::string_view text);
+public:
+    // Диапазон значений одного поля; nullptr — граница не задана
+    struct Range {
+        const nlohmann::json* lower = nullptr;
+        bool lowerInclusive = false;
+        const nlohmann::json* upper = nullptr;
+        bool upperInclusive = false;
+    };
+
+    explicit Query(const nlohmann::json& query);
+
+    // переводит имена полей в номера словаря; нужен до matches()
+    void bind(const FieldDictionary& dictionary);
+    [[nodiscard]] bool matches(const BinaryDocument& doc) const;
+
+    // Ищет проиндексированное поле, которое ограничивает результат через $eq,
+    // неявное равенство или $in: любой подходящий документ имеет в field одно
+    // из values. Указатели ссылаются на данные запроса.
+    bool findIndexProbe(const std::function<bool(const std::string&)>& hasIndex,
+                        std::string& field, std::vector<const nlohmann::json*>& values) const;
+
+    // Ищет поле с упорядоченным индексом, которое ограничено сравнениями
+    // ($gt, $gte, $lt, $lte или равенством со скаляром); все ограничения
+    // на это поле сводятся в один диапазон.
+    bool findRangeProbe(const std::function<bool(const std::string&)>& hasIndex,
+                        std::string& field, Range& range) const;
+private:
+    static bool rangeNode(const Node& node, const std::function<bool(const std::string&)>& hasIndex,
+                          std::string& field, Range& range);
+};
+
+
+#endif //PROVERKA_QUERY_H
@@ -0,0 +1,125 @@
+#include "RangeIndex.h"
+
+#include <cmath>
+#include <utility>
+
+using namespace std;
+using namespace nlohmann;
+
+RangeIndex::SkipNode::SkipNode(json value, int nodeLevel) : key(std::move(value)), level(nodeLevel) {
+    next = new SkipNode*[nodeLevel];
+    for (int i = 0; i < nodeLevel; i++) next[i] = nullptr;
+}
+
+RangeIndex::SkipNode::~SkipNode() {
+    delete[] next;
+}
+
+RangeIndex::RangeIndex(std::string fieldName, FieldDictionary &dictionary) :
+                                                 field(std::move(fieldName)),
+                                                 fieldId(dictionary.intern(field)),
+                                                 fields(&dictionary),
+                                                 head(new SkipNode(nullptr, MAX_LEVEL)),
+                                                 level(1),
+                                                 gen(std::random_device{}()) {}
+
+RangeIndex::RangeIndex(RangeIndex &&other) noexcept : field(std::move(other.field)),
+                                                      fieldId(other.fieldId),
+                                                      fields(other.fields),
+                                                      head(other.head),
+                                                      level(other.level),
+                                                      gen(other.gen) {
+    other.head = nullptr;
+}
+
+RangeIndex::~RangeIndex() {
+    while (head != nullptr) {
+        SkipNode* temp = head;
+        head = head->next[0];
+        delete temp;
+    }
+}
+
+int RangeIndex::randomLevel() {
+    // вероятность подняться на уровень выше — 1/4
+    int result = 1;
+    while (result < MAX_LEVEL && (gen() & 3) == 0) result++;
+    return result;
+}
+
+bool RangeIndex::isIndexable(const nlohmann::json &value) {
+    if (value.is_number_float() && std::isnan(value.get<double>())) return false;
+    return value.is_number() || value.is_string();
+}
+
+void RangeIndex::findPredecessors(const nlohmann::json &value, SkipNode **update) const {
+    SkipNode* current = head;
+    for (int i = level - 1; i >= 0; i--) {
+        while (current->next[i] != nullptr && current->next[i]->key < value) {
+            current = current->next[i];
+        }
+        update[i] = current;
+    }
+}
+
+RangeIndex::SkipNode* RangeIndex::lowerBound(const nlohmann::json &value) const {
+    SkipNode* current = head;
+    for (int i = level - 1; i >= 0; i--) {
+        while (current->next[i] != nullptr && current->next[i]->key < value) {
+            current = current->next[i];
+        }
+    }
+    return current->next[0];
+}
+
+void RangeIndex::add(const std::string &id, const BinaryDocument &doc) {
+    const auto value = doc.find(fieldId);
+    if (!value) return;
+    json key = value.toJson(*fields);
+    if (!isIndexable(key)) return;
+
+    SkipNode* update[MAX_LEVEL];
+    findPredecessors(key, update);
+
+    // 5 и 5.0 равны для json ==, поэтому попадают в один узел
+    SkipNode* candidate = update[0]->next[0];
+    if (candidate != nullptr && !(key < candidate->key)) {
+        candidate->ids.insert(id);
+        return;
+    }
+
+    const int nodeLevel = randomLevel();
+    if (nodeLevel > level) {
+        for (int i = level; i < nodeLevel; i++) update[i] = head;
+        level = nodeLevel;
+    }
+
+    auto node = new SkipNode(std::move(key), nodeLevel);
+    node->ids.insert(id);
+    for (int i = 0; i < nodeLevel; i++) {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+    }
+}
+
+void RangeIndex::remove(const std::string &id, const BinaryDocument &doc) {
+    const auto value = doc.find(fieldId);
+    if (!value) return;
+    const json key = value.toJson(*fields);
+    if (!isIndexable(key)) return;
+
+    SkipNode* update[MAX_LEVEL];
+    findPredecessors(key, update);
+
+    SkipNode* node = update[0]->next[0];
+    if (node == nullptr || key < node->key) return;
+
+    node->ids.erase(id);
+    if (!node->ids.empty()) return;
+
+    for (int i = 0; i < node->level; i++) {
+        if (update[i]->next[i] == node) update[i]->next[i] = node->next[i];
+    }
+    delete node;
+    while (level > 1 && head->next[level - 1] == nullptr) level--;
+}
@@ -0,0 +1,76 @@
+#ifndef PROVERKA_RANGEINDEX_H
+#define PROVERKA_RANGEINDEX_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+#include "BinaryDocument.h"
+#include "json.hpp"
+
+// Упорядоченный вторичный индекс по одному полю на списке с пропусками.
+// Ключи упорядочены операторами сравнения nlohmann::json, теми же, что
+// используют $gt/$lt/$gte/$lte, поэтому поиск по диапазону даёт ровно те
+// документы, которые прошли бы сравнение. Индексируются только числа и строки,
+// остальные типы операторы диапазона всё равно отбрасывают.
+class RangeIndex {
+private:
+    static constexpr int MAX_LEVEL = 32;
+
+    struct SkipNode {
+        nlohmann::json key;
+        std::unordered_set<std::string> ids;
+        int level;
+        SkipNode** next;
+
+        SkipNode(nlohmann::json value, int nodeLevel);
+        ~SkipNode();
+    };
+
+    std::string field;
+    uint32_t fieldId;
+    const FieldDictionary* fields;
+    SkipNode* head;
+    int level;
+    std::mt19937 gen;
+
+    [[nodiscard]] int randomLevel();
+    // последний узел на каждом уровне с ключом меньше value
+    void findPredecessors(const nlohmann::json& value, SkipNode** update) const;
+    [[nodiscard]] SkipNode* lowerBound(const nlohmann::json& value) const;
+    [[nodiscard]] static bool isIndexable(const nlohmann::json& value);
+public:
+    // имя поля заносится в словарь коллекции, даже если его ещё нет в документах
+    RangeIndex(std::string fieldName, FieldDictionary& dictionary);
+    ~RangeIndex();
+
+    RangeIndex(const RangeIndex&) = delete;
+    RangeIndex& operator=(const RangeIndex&) = delete;
+    RangeIndex(RangeIndex&& other) noexcept;
+
+    [[nodiscard]] const std::string& getField() const { return field; }
+
+    void add(const std::string& id, const BinaryDocument& doc);
+    void remove(const std::string& id, const BinaryDocument& doc);
+
+    // вызывает visit(id) для всех документов с ключом в заданном диапазоне;
+    // nullptr вместо границы означает, что диапазон с этой стороны открыт
+    template<typename F>
+    void forEachInRange(const nlohmann::json* lower, bool lowerInclusive,
+                        const nlohmann::json* upper, bool upperInclusive, F&& visit) const {
+        SkipNode* node = lower == nullptr ? head->next[0] : lowerBound(*lower);
+        if (lower != nullptr && !lowerInclusive) {
+            while (node != nullptr && !(*lower < node->key)) node = node->next[0];
+        }
+        for (; node != nullptr; node = node->next[0]) {
+            if (upper != nullptr) {
+                if (upperInclusive ? *upper < node->key : !(node->key < *upper)) break;
+            }
+            for (const auto& id : node->ids) visit(id);
+        }
+    }
+};
+
+
+#endif //PROVERKA_RANGEINDEX_H
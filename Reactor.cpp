@@ -0,0 +1,572 @@
+#include "Reactor.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Frame.h"
+#include "json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    const int MAX_EVENTS = 256;
+    const int SWEEP_INTERVAL_MS = 1000;
+    const int RETRY_INTERVAL_MS = 5;
+    const size_t READ_CHUNK = 16384;
+    // разобранное начало входного буфера сдвигаем, когда его набралось столько
+    const size_t COMPACT_THRESHOLD = 64 * 1024;
+    // сколько непрочитанных запросов держим в буфере соединения
+    const size_t READ_AHEAD_LIMIT = 256 * 1024;
+
+    string peerName(const sockaddr_in& address) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &address.sin_addr, ip, INET_ADDRSTRLEN);
+        return string(ip) + ":" + to_string(ntohs(address.sin_port));
+    }
+
+    // У старых клиентов без кадров граница сообщения определяется разбором:
+    // ошибка в самом конце буфера значит, что сообщение пришло не целиком.
+    // Дерево документа при этом не строится, события разбора отбрасываются.
+    struct BoundarySax : json::json_sax_t {
+        size_t errorAt = 0;
+
+        bool null() override { return true; }
+        bool boolean(bool) override { return true; }
+        bool number_integer(number_integer_t) override { return true; }
+        bool number_unsigned(number_unsigned_t) override { return true; }
+        bool number_float(number_float_t, const string_t&) override { return true; }
+        bool string(string_t&) override { return true; }
+        bool binary(binary_t&) override { return true; }
+        bool start_object(size_t) override { return true; }
+        bool key(string_t&) override { return true; }
+        bool end_object() override { return true; }
+        bool start_array(size_t) override { return true; }
+        bool end_array() override { return true; }
+        bool parse_error(size_t position, const std::string&, const json::exception&) override {
+            errorAt = position;
+            return false;
+        }
+    };
+
+    bool messageComplete(const std::string_view buffer) {
+        if (buffer == "exit") {
+            return true;
+        }
+        BoundarySax sax;
+        if (json::sax_parse(buffer.begin(), buffer.end(), &sax)) {
+            return true;
+        }
+        return sax.errorAt <= buffer.size();
+    }
+}
+
+Connection::Connection(const int socket, string address, IoLoop* owner)
+    : fd(socket), peer(std::move(address)), loop(owner), lastActive(chrono::steady_clock::now()) {}
+
+IoLoop::IoLoop(const int listenSocket, const ReactorCallbacks& handlers, const ReactorLimits& reactorLimits,
+               const vector<IoLoop*>& allLoops)
+    : listenFd(listenSocket), spareFd(-1), callbacks(handlers), limits(reactorLimits), loops(allLoops) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        throw runtime_error("epoll_create1: " + string(strerror(errno)));
+    }
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        close(epollFd);
+        throw runtime_error("eventfd: " + string(strerror(errno)));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    if (listenFd >= 0) {
+        event.data.fd = listenFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0) {
+            close(wakeFd);
+            close(epollFd);
+            throw runtime_error("epoll_ctl(listen): " + string(strerror(errno)));
+        }
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+}
+
+IoLoop::~IoLoop() {
+    for (auto& [fd, conn] : connections) {
+        close(fd);
+    }
+    if (spareFd >= 0) {
+        close(spareFd);
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void IoLoop::wake() const {
+    const uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written; // EAGAIN значит, что поток уже разбужен
+}
+
+void IoLoop::post(const ConnectionPtr& conn) {
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        incoming.push_back(conn);
+    }
+    wake();
+}
+
+void IoLoop::complete(Response&& response) {
+    bool first;
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        first = responses.empty();
+        responses.push_back(std::move(response));
+    }
+    // если очередь не пуста, поток уже разбужен и заберёт ответ вместе с прочими
+    if (first) {
+        wake();
+    }
+}
+
+void IoLoop::acceptClients() {
+    while (true) {
+        sockaddr_in address{};
+        socklen_t size = sizeof(address);
+        const int client = accept4(listenFd, reinterpret_cast<sockaddr*>(&address), &size,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && spareFd >= 0) {
+                // без свободного дескриптора соединение так и висело бы в очереди,
+                // а epoll будил бы нас снова и снова; принимаем его и сразу закрываем
+                close(spareFd);
+                const int dropped = accept(listenFd, nullptr, nullptr);
+                if (dropped >= 0) {
+                    close(dropped);
+                }
+                spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                cerr << "Ошибка при принятии подключения: нет свободных дескрипторов" << endl;
+                return;
+            }
+            cerr << "Ошибка при принятии подключения: " << strerror(errno) << endl;
+            return;
+        }
+
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        IoLoop* target = loops[nextLoop];
+        nextLoop = (nextLoop + 1) % loops.size();
+        auto conn = make_shared<Connection>(client, peerName(address), target);
+        if (target == this) {
+            adopt(conn);
+        } else {
+            target->post(conn);
+        }
+    }
+}
+
+void IoLoop::adopt(const ConnectionPtr& conn) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = conn->fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->fd, &event) < 0) {
+        cerr << "Ошибка регистрации соединения " << conn->peer << ": " << strerror(errno) << endl;
+        close(conn->fd);
+        conn->closed = true;
+        return;
+    }
+    conn->events = EPOLLIN;
+    connections[conn->fd] = conn;
+    if (callbacks.onOpen) {
+        callbacks.onOpen(conn);
+    }
+}
+
+// Читать дальше стоит, пока буфер не превысил READ_AHEAD_LIMIT или пока
+// в нём не целиком лежит кадр, который всё равно придётся дочитать.
+bool IoLoop::wantsInput(const ConnectionPtr& conn) const {
+    if (conn->peerClosed || conn->closing) {
+        return false;
+    }
+    const size_t buffered = conn->inBuffer.size() - conn->inOffset;
+    if (buffered < READ_AHEAD_LIMIT) {
+        return true;
+    }
+    if (conn->format != WireFormat::Framed) {
+        return false;
+    }
+    const uint32_t length = readFrameLength(conn->inBuffer.data() + conn->inOffset);
+    return length <= limits.maxFrame && buffered < FRAME_HEADER_SIZE + length;
+}
+
+void IoLoop::readFrom(const ConnectionPtr& conn) {
+    char buffer[READ_CHUNK];
+    while (wantsInput(conn)) {
+        const ssize_t bytesRead = recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (bytesRead > 0) {
+            conn->inBuffer.append(buffer, bytesRead);
+            conn->lastActive = chrono::steady_clock::now();
+            continue;
+        }
+        if (bytesRead == 0) {
+            // клиент закрыл запись: отвечаем на всё, что он успел прислать
+            conn->peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        closeConnection(conn, "Ошибка приема данных: " + string(strerror(errno)));
+        return;
+    }
+    advance(conn);
+}
+
+IoLoop::Take IoLoop::takeMessage(const ConnectionPtr& conn, string& message) const {
+    string& buffer = conn->inBuffer;
+    const size_t available = buffer.size() - conn->inOffset;
+    if (available == 0) {
+        return Take::Nothing;
+    }
+    if (conn->format == WireFormat::Unknown) {
+        conn->format = looksFramed(buffer[conn->inOffset]) ? WireFormat::Framed : WireFormat::Raw;
+    }
+
+    if (conn->format == WireFormat::Framed) {
+        if (available < FRAME_HEADER_SIZE) {
+            return Take::Nothing;
+        }
+        const uint32_t length = readFrameLength(buffer.data() + conn->inOffset);
+        if (length > limits.maxFrame) {
+            return Take::TooLarge;
+        }
+        if (available < FRAME_HEADER_SIZE + length) {
+            return Take::Nothing;
+        }
+        message.assign(buffer, conn->inOffset + FRAME_HEADER_SIZE, length);
+        conn->inOffset += FRAME_HEADER_SIZE + length;
+    } else {
+        // слишком длинное сообщение отдаём как есть, сервер ответит ошибкой разбора
+        const string_view pending(buffer.data() + conn->inOffset, available);
+        if (!conn->peerClosed && available < limits.maxRawMessage && !messageComplete(pending)) {
+            return Take::Nothing;
+        }
+        message.assign(pending);
+        conn->inOffset = buffer.size();
+    }
+
+    if (conn->inOffset == buffer.size()) {
+        buffer.clear();
+        conn->inOffset = 0;
+    } else if (conn->inOffset >= COMPACT_THRESHOLD && conn->inOffset * 2 >= buffer.size()) {
+        buffer.erase(0, conn->inOffset);
+        conn->inOffset = 0;
+    }
+    return Take::Message;
+}
+
+// Передаёт исполнителю следующий запрос из буфера, если предыдущий уже
+// выполнен и лимит запросов без ответа не исчерпан.
+void IoLoop::dispatch(const ConnectionPtr& conn) {
+    const size_t maxInFlight = conn->format == WireFormat::Raw ? 1 : limits.maxInFlight;
+    if (conn->closed || conn->closing || conn->executing || conn->inFlight >= maxInFlight) {
+        return;
+    }
+    string message;
+    const Take taken = takeMessage(conn, message);
+    if (taken == Take::TooLarge) {
+        json error;
+        error["status"] = "error";
+        error["message"] = "frame exceeds " + to_string(limits.maxFrame) + " bytes";
+        appendFrame(conn->outBuffer, error.dump());
+        conn->closing = true;
+        writeTo(conn);
+        return;
+    }
+    if (taken == Take::Nothing) {
+        return;
+    }
+
+    conn->executing = true;
+    conn->inFlight++;
+    if (!deferred.empty() || !callbacks.onRequest(conn, message)) {
+        deferred.emplace_back(conn, std::move(message));
+    }
+}
+
+void IoLoop::retryDeferred() {
+    while (!deferred.empty()) {
+        auto& [conn, message] = deferred.front();
+        if (!conn->closed && !callbacks.onRequest(conn, message)) {
+            return;
+        }
+        deferred.pop_front();
+    }
+}
+
+void IoLoop::writeTo(const ConnectionPtr& conn) {
+    while (conn->outOffset < conn->outBuffer.size()) {
+        const ssize_t sent = send(conn->fd, conn->outBuffer.data() + conn->outOffset,
+                                  conn->outBuffer.size() - conn->outOffset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            closeConnection(conn, "Ошибка отправки данных: " + string(strerror(errno)));
+            return;
+        }
+        conn->outOffset += sent;
+    }
+    conn->outBuffer.clear();
+    conn->outOffset = 0;
+    conn->lastActive = chrono::steady_clock::now();
+}
+
+// Закрывает соединение, если ему больше нечего делать: клиент попросил
+// выйти или закрыл свою сторону, и все ответы уже отправлены.
+bool IoLoop::finishIfDone(const ConnectionPtr& conn) {
+    if (conn->closed) {
+        return true;
+    }
+    if (conn->inFlight > 0 || !conn->outBuffer.empty()) {
+        return false;
+    }
+    if (conn->closing) {
+        closeConnection(conn, conn->peerClosed ? "Клиент отключился корректно" : "Клиент запросил выход");
+        return true;
+    }
+    if (conn->peerClosed) {
+        // всё целое уже разобрано; если что-то осталось, это обрывок
+        closeConnection(conn, conn->inOffset == conn->inBuffer.size()
+                                  ? "Клиент отключился корректно"
+                                  : "Клиент отключился, не дослав запрос");
+        return true;
+    }
+    return false;
+}
+
+void IoLoop::advance(const ConnectionPtr& conn) {
+    dispatch(conn);
+    if (!finishIfDone(conn)) {
+        updateInterest(conn);
+    }
+}
+
+void IoLoop::updateInterest(const ConnectionPtr& conn) const {
+    uint32_t wanted = 0;
+    if (wantsInput(conn)) {
+        wanted |= EPOLLIN;
+    }
+    if (!conn->outBuffer.empty()) {
+        wanted |= EPOLLOUT;
+    }
+    if (wanted == conn->events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = wanted;
+    event.data.fd = conn->fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = wanted;
+}
+
+void IoLoop::closeConnection(const ConnectionPtr& conn, const string& reason) {
+    if (conn->closed) {
+        return;
+    }
+    conn->closed = true;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    ConnectionPtr keep = conn;
+    connections.erase(conn->fd);
+    if (callbacks.onClose) {
+        callbacks.onClose(keep, reason);
+    }
+}
+
+void IoLoop::drainPending() {
+    uint64_t counter;
+    ssize_t drained = read(wakeFd, &counter, sizeof(counter));
+    (void)drained;
+
+    vector<ConnectionPtr> newConnections;
+    vector<Response> ready;
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        newConnections.swap(incoming);
+        ready.swap(responses);
+    }
+    for (const auto& conn : newConnections) {
+        adopt(conn);
+    }
+
+    // сначала собираем все ответы, чтобы ответы одному соединению ушли одним send
+    vector<ConnectionPtr> touched;
+    for (auto& response : ready) {
+        const ConnectionPtr& conn = response.conn;
+        if (conn->closed) {
+            continue; // клиент ушёл, пока запрос выполнялся
+        }
+        if (response.releases) {
+            conn->executing = false;
+        }
+        if (response.delivers) {
+            conn->inFlight--;
+            conn->closing = conn->closing || response.closeAfter;
+            if (conn->format == WireFormat::Framed) {
+                appendFrame(conn->outBuffer, response.body);
+            } else {
+                conn->outBuffer.append(response.body);
+            }
+        }
+        if (!conn->flushPending) {
+            conn->flushPending = true;
+            touched.push_back(conn);
+        }
+    }
+    for (const auto& conn : touched) {
+        conn->flushPending = false;
+        if (conn->closed) {
+            continue;
+        }
+        writeTo(conn);
+        if (!conn->closed) {
+            advance(conn);
+        }
+    }
+}
+
+void IoLoop::sweepIdle() {
+    const auto now = chrono::steady_clock::now();
+    vector<ConnectionPtr> idle;
+    for (const auto& [fd, conn] : connections) {
+        if (conn->inFlight == 0 && conn->outBuffer.empty() && now - conn->lastActive >= limits.idleTimeout) {
+            idle.push_back(conn);
+        }
+    }
+    for (const auto& conn : idle) {
+        closeConnection(conn, "Таймаут ожидания данных от клиента");
+    }
+}
+
+void IoLoop::run() {
+    epoll_event events[MAX_EVENTS];
+    auto lastSweep = chrono::steady_clock::now();
+
+    while (true) {
+        const int timeout = deferred.empty() ? SWEEP_INTERVAL_MS : RETRY_INTERVAL_MS;
+        const int count = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            cerr << "Ошибка epoll_wait: " << strerror(errno) << endl;
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                drainPending();
+                continue;
+            }
+            if (fd == listenFd) {
+                acceptClients();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue; // закрыто раньше в этой же пачке событий
+            }
+            ConnectionPtr conn = it->second;
+            const uint32_t flags = events[i].events;
+
+            if (flags & EPOLLERR) {
+                closeConnection(conn, "Ошибка сокета");
+                continue;
+            }
+            if (flags & EPOLLOUT) {
+                writeTo(conn);
+                if (!conn->closed) {
+                    advance(conn);
+                }
+            }
+            if (!conn->closed && (flags & (EPOLLIN | EPOLLHUP))) {
+                if (conn->events & EPOLLIN) {
+                    readFrom(conn);
+                } else {
+                    // сокет не читаем, значит это обрыв: клиент не дождался ответов
+                    closeConnection(conn, "Клиент отключился до ответа");
+                }
+            }
+        }
+
+        retryDeferred();
+
+        const auto now = chrono::steady_clock::now();
+        if (now - lastSweep >= chrono::milliseconds(SWEEP_INTERVAL_MS)) {
+            sweepIdle();
+            lastSweep = now;
+        }
+    }
+}
+
+Reactor::Reactor(const int listenSocket, size_t ioThreads, ReactorLimits reactorLimits, ReactorCallbacks handlers)
+    : callbacks(std::move(handlers)), limits(reactorLimits) {
+    const int flags = fcntl(listenSocket, F_GETFL, 0);
+    if (flags < 0 || fcntl(listenSocket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw runtime_error("fcntl(O_NONBLOCK): " + string(strerror(errno)));
+    }
+    if (ioThreads == 0) {
+        ioThreads = 1;
+    }
+    for (size_t i = 0; i < ioThreads; i++) {
+        ownedLoops.push_back(make_unique<IoLoop>(i == 0 ? listenSocket : -1, callbacks, limits, loops));
+        loops.push_back(ownedLoops.back().get());
+    }
+}
+
+void Reactor::respond(const ConnectionPtr& conn, string&& response, const bool closeAfter) {
+    conn->loop->complete({conn, std::move(response), closeAfter, true, true});
+}
+
+void Reactor::release(const ConnectionPtr& conn) {
+    conn->loop->complete({conn, string(), false, true, false});
+}
+
+void Reactor::deliver(const ConnectionPtr& conn, string&& response, const bool closeAfter) {
+    conn->loop->complete({conn, std::move(response), closeAfter, false, true});
+}
+
+void Reactor::run() {
+    vector<thread> threads;
+    for (size_t i = 1; i < loops.size(); i++) {
+        threads.emplace_back(&IoLoop::run, loops[i]);
+    }
+    loops[0]->run();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
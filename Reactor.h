@@ -0,0 +1,155 @@
+#ifndef PROVERKA_REACTOR_H
+#define PROVERKA_REACTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class IoLoop;
+
+// Формат сообщений соединения определяется по первому байту первого
+// запроса (см. Frame.h) и дальше не меняется.
+enum class WireFormat { Unknown, Raw, Framed };
+
+// Одно клиентское соединение. Буферы и флаги меняет только поток
+// ввода-вывода, которому принадлежит соединение; исполнители держат
+// shared_ptr и отвечают через Reactor::respond.
+struct Connection {
+    int fd;
+    std::string peer;
+    IoLoop* loop;
+
+    WireFormat format = WireFormat::Unknown;
+    std::string inBuffer;
+    size_t inOffset = 0;     // начало ещё не разобранных данных в inBuffer
+    std::string outBuffer;
+    size_t outOffset = 0;
+    bool executing = false;  // запрос у исполнителя, следующий ждёт
+    size_t inFlight = 0;     // запросы, на которые ещё нет ответа
+    bool closing = false;    // закрыть, когда уйдут все ответы
+    bool peerClosed = false; // клиент закрыл свою сторону, новых данных не будет
+    bool closed = false;
+    bool flushPending = false;
+    uint32_t events = 0;     // маска, зарегистрированная в epoll
+    std::chrono::steady_clock::time_point lastActive;
+
+    Connection(int socket, std::string address, IoLoop* owner);
+};
+
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+// onRequest вызывается в потоке ввода-вывода и должен только передать
+// запрос исполнителю. Если исполнитель перегружен, onRequest возвращает
+// false и не трогает сообщение: запрос повторяется позже, а сокет до тех
+// пор не читается, и клиент упирается в окно TCP. onClose получает
+// причину закрытия для журнала.
+struct ReactorCallbacks {
+    std::function<void(const ConnectionPtr&)> onOpen;
+    std::function<bool(const ConnectionPtr&, std::string&)> onRequest;
+    std::function<void(const ConnectionPtr&, const std::string&)> onClose;
+};
+
+struct ReactorLimits {
+    size_t maxRawMessage;    // голый JSON старых клиентов
+    size_t maxFrame;         // полезная нагрузка кадра
+    size_t maxInFlight;      // запросов без ответа на одно соединение с кадрами
+    std::chrono::seconds idleTimeout;
+};
+
+// Поток ввода-вывода: свой epoll, свои соединения и очередь готовых
+// ответов, о которой его будит eventfd.
+class IoLoop {
+public:
+    struct Response {
+        ConnectionPtr conn;
+        std::string body;
+        bool closeAfter;
+        bool releases;       // исполнитель закончил с запросом
+        bool delivers;       // в body лежит ответ
+    };
+private:
+    int epollFd;
+    int wakeFd;
+    int listenFd;      // -1 у всех потоков, кроме принимающего
+    int spareFd;       // резерв на случай EMFILE, см. acceptClients
+    const ReactorCallbacks& callbacks;
+    const ReactorLimits& limits;
+    const std::vector<IoLoop*>& loops;
+    size_t nextLoop = 0;
+
+    std::unordered_map<int, ConnectionPtr> connections;
+    // запросы, которые исполнитель не принял, в порядке поступления
+    std::deque<std::pair<ConnectionPtr, std::string>> deferred;
+
+    std::mutex pendingMutex;
+    std::vector<ConnectionPtr> incoming;
+    std::vector<Response> responses;
+
+    void wake() const;
+    void acceptClients();
+    void adopt(const ConnectionPtr& conn);
+    bool wantsInput(const ConnectionPtr& conn) const;
+    void readFrom(const ConnectionPtr& conn);
+    enum class Take { Nothing, Message, TooLarge };
+    Take takeMessage(const ConnectionPtr& conn, std::string& message) const;
+    void dispatch(const ConnectionPtr& conn);
+    void writeTo(const ConnectionPtr& conn);
+    bool finishIfDone(const ConnectionPtr& conn);
+    void advance(const ConnectionPtr& conn);
+    void updateInterest(const ConnectionPtr& conn) const;
+    void closeConnection(const ConnectionPtr& conn, const std::string& reason);
+    void drainPending();
+    void retryDeferred();
+    void sweepIdle();
+public:
+    IoLoop(int listenSocket, const ReactorCallbacks& handlers, const ReactorLimits& reactorLimits,
+           const std::vector<IoLoop*>& allLoops);
+    ~IoLoop();
+
+    IoLoop(const IoLoop&) = delete;
+    IoLoop& operator=(const IoLoop&) = delete;
+
+    void post(const ConnectionPtr& conn);
+    void complete(Response&& response);
+    void run();
+};
+
+// Неблокирующий сервер на epoll вместо потока на каждого клиента.
+// Первый поток принимает соединения и раздаёт их по кругу всем потокам
+// ввода-вывода. Ответ уходит в том же формате, в каком пришёл запрос.
+//
+// Соединение с кадрами может прислать до maxInFlight запросов, не дожидаясь
+// ответов. Исполнителю они передаются по одному в порядке поступления,
+// поэтому каждый запрос видит результат предыдущих; ответы же отправляются
+// по готовности и сопоставляются с запросами по id. У старых клиентов без
+// кадров на соединении по-прежнему один запрос.
+class Reactor {
+private:
+    ReactorCallbacks callbacks;
+    ReactorLimits limits;
+    std::vector<std::unique_ptr<IoLoop>> ownedLoops;
+    std::vector<IoLoop*> loops;
+public:
+    Reactor(int listenSocket, size_t ioThreads, ReactorLimits reactorLimits, ReactorCallbacks handlers);
+
+    // Все три можно вызывать из любого потока. respond — запрос выполнен
+    // и вот ответ. Если ответ ждёт ещё чего-то (например, fsync), сначала
+    // release, чтобы соединение передало исполнителю следующий запрос,
+    // а потом deliver с ответом. closeAfter закрывает соединение после ответа.
+    static void respond(const ConnectionPtr& conn, std::string&& response, bool closeAfter = false);
+    static void release(const ConnectionPtr& conn);
+    static void deliver(const ConnectionPtr& conn, std::string&& response, bool closeAfter = false);
+
+    // блокирует вызывающий поток, он становится первым потоком ввода-вывода
+    void run();
+};
+
+
+#endif //PROVERKA_REACTOR_H
@@ -0,0 +1,46 @@
+#include "RwLock.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+RwLock::RwLock() {
+    pthread_rwlockattr_t attributes;
+    pthread_rwlockattr_init(&attributes);
+    pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    const int error = pthread_rwlock_init(&lockHandle, &attributes);
+    pthread_rwlockattr_destroy(&attributes);
+    if (error != 0) {
+        throw runtime_error("pthread_rwlock_init: " + string(strerror(error)));
+    }
+}
+
+RwLock::~RwLock() {
+    pthread_rwlock_destroy(&lockHandle);
+}
+
+void RwLock::lock() {
+    pthread_rwlock_wrlock(&lockHandle);
+}
+
+bool RwLock::try_lock() {
+    return pthread_rwlock_trywrlock(&lockHandle) == 0;
+}
+
+void RwLock::unlock() {
+    pthread_rwlock_unlock(&lockHandle);
+}
+
+void RwLock::lock_shared() {
+    pthread_rwlock_rdlock(&lockHandle);
+}
+
+bool RwLock::try_lock_shared() {
+    return pthread_rwlock_tryrdlock(&lockHandle) == 0;
+}
+
+void RwLock::unlock_shared() {
+    pthread_rwlock_unlock(&lockHandle);
+}
@@ -0,0 +1,32 @@
+#ifndef PROVERKA_RWLOCK_H
+#define PROVERKA_RWLOCK_H
+
+#include <pthread.h>
+
+// Блокировка чтения-записи с приоритетом писателя. std::shared_mutex в glibc
+// пропускает новых читателей, пока кто-то читает, и при постоянном потоке
+// find вставка может не дождаться блокировки никогда. Здесь ожидающий
+// писатель не пускает новых читателей.
+//
+// Подходит для std::shared_lock и std::unique_lock.
+class RwLock {
+private:
+    pthread_rwlock_t lockHandle;
+public:
+    RwLock();
+    ~RwLock();
+
+    RwLock(const RwLock&) = delete;
+    RwLock& operator=(const RwLock&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+};
+
+
+#endif //PROVERKA_RWLOCK_H
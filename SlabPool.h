@@ -0,0 +1,119 @@
+#ifndef PROVERKA_SLABPOOL_H
+#define PROVERKA_SLABPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Пул объектов одного типа, нарезанных из блоков (слэбов) по SLAB_BYTES.
+// Слэб выровнен по своему размеру, поэтому release находит его по адресу
+// объекта, без заголовка у каждого объекта. Объекты одной таблицы лежат
+// рядом, а не по всей куче, и обход идёт по соседним страницам.
+//
+// Свободные места выдаются из частично занятых слэбов; опустевший слэб
+// возвращается в кучу, кроме одного запасного. Пул не потокобезопасен:
+// выделяет и освобождает только писатель таблицы.
+template<typename T>
+class SlabPool {
+private:
+    static constexpr size_t SLAB_BYTES = 64 * 1024;
+
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+    struct Slab {
+        SlabPool* pool;
+        Slab* prev;        // список слэбов со свободными местами
+        Slab* next;
+        Slot* freeList;
+        size_t bumped;     // мест, нарезанных хотя бы раз
+        size_t live;
+    };
+    static constexpr size_t HEADER_BYTES = (sizeof(Slab) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+    static constexpr size_t SLOTS_PER_SLAB = (SLAB_BYTES - HEADER_BYTES) / sizeof(Slot);
+
+    Slab* partial = nullptr;
+    size_t slabs = 0;
+    size_t live = 0;
+
+    static Slot* slotAt(Slab* slab, const size_t index) {
+        return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(slab) + HEADER_BYTES) + index;
+    }
+    static Slab* slabOf(const void* object) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(object) & ~(SLAB_BYTES - 1));
+    }
+    void link(Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = partial;
+        if (partial != nullptr) partial->prev = slab;
+        partial = slab;
+    }
+    void unlink(Slab* slab) {
+        if (slab->prev != nullptr) slab->prev->next = slab->next;
+        else partial = slab->next;
+        if (slab->next != nullptr) slab->next->prev = slab->prev;
+    }
+    Slab* grow() {
+        void* memory = std::aligned_alloc(SLAB_BYTES, SLAB_BYTES);
+        if (memory == nullptr) throw std::bad_alloc();
+        auto* slab = new (memory) Slab{this, nullptr, nullptr, nullptr, 0, 0};
+        slabs++;
+        link(slab);
+        return slab;
+    }
+public:
+    SlabPool() = default;
+    ~SlabPool() {
+        // к этому моменту все объекты уже освобождены и остались только пустые слэбы
+        while (partial != nullptr) {
+            Slab* slab = partial;
+            partial = slab->next;
+            std::free(slab);
+        }
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    void* allocate() {
+        Slab* slab = partial != nullptr ? partial : grow();
+        Slot* slot;
+        if (slab->freeList != nullptr) {
+            slot = slab->freeList;
+            slab->freeList = slot->next;
+        } else {
+            slot = slotAt(slab, slab->bumped++);
+        }
+        if (++slab->live == SLOTS_PER_SLAB) unlink(slab);
+        live++;
+        return slot;
+    }
+
+    // освобождает место объекта из любого пула этого типа
+    static void release(void* object) {
+        Slab* slab = slabOf(object);
+        SlabPool* pool = slab->pool;
+        if (slab->live == SLOTS_PER_SLAB) pool->link(slab);
+
+        auto* slot = static_cast<Slot*>(object);
+        slot->next = slab->freeList;
+        slab->freeList = slot;
+        slab->live--;
+        pool->live--;
+
+        if (slab->live == 0 && (slab->prev != nullptr || slab->next != nullptr)) {
+            pool->unlink(slab);
+            pool->slabs--;
+            std::free(slab);
+        }
+    }
+
+    [[nodiscard]] size_t liveObjects() const { return live; }
+    [[nodiscard]] size_t slabCount() const { return slabs; }
+    [[nodiscard]] size_t reservedBytes() const { return slabs * SLAB_BYTES; }
+};
+
+
+#endif //PROVERKA_SLABPOOL_H
@@ -0,0 +1,58 @@
+#include "ThreadPool.h"
+
+#include <exception>
+
+#include "Logger.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        tasks.push_back(std::move(task));
+    }
+    queueReady.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        try {
+            task();
+        } catch (const exception& e) {
+            // одна сломанная задача не должна завершать весь сервер
+            Logger::log(LogLevel::Error, string("Ошибка в задаче пула: ") + e.what());
+        } catch (...) {
+            Logger::log(LogLevel::Error, "Неизвестная ошибка в задаче пула");
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef PROVERKA_THREADPOOL_H
+#define PROVERKA_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Простой пул: фиксированное число потоков и общая очередь задач без
+// ограничения. Подходит для задач, которые в основном ждут (например, fsync
+// журнала); работу с базой выполняет WorkStealingPool.
+class ThreadPool {
+private:
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    void workerLoop();
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+};
+
+
+#endif //PROVERKA_THREADPOOL_H
@@ -0,0 +1,115 @@
+#include "WorkStealingPool.h"
+
+#include <exception>
+
+#include "Logger.h"
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(size_t threads, const size_t capacityPerThread)
+    : queueCapacity(capacityPerThread == 0 ? 1 : capacityPerThread) {
+    if (threads == 0) {
+        threads = thread::hardware_concurrency();
+        if (threads == 0) {
+            threads = 4;
+        }
+    }
+    for (size_t i = 0; i < threads; i++) {
+        queues.push_back(make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(idleMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool WorkStealingPool::trySubmit(function<void()> task) {
+    // начинаем с очередной очереди по кругу; если она полна, пробуем следующие
+    const size_t start = nextQueue.fetch_add(1, memory_order_relaxed);
+    bool placed = false;
+    for (size_t i = 0; i < queues.size() && !placed; i++) {
+        WorkerQueue& queue = *queues[(start + i) % queues.size()];
+        lock_guard<mutex> lock(queue.lock);
+        if (queue.tasks.size() < queueCapacity) {
+            queue.tasks.push_back(std::move(task));
+            queued.fetch_add(1, memory_order_release);
+            placed = true;
+        }
+    }
+    if (!placed) {
+        return false;
+    }
+
+    {
+        // под замком, чтобы не разминуться с потоком, который как раз засыпает
+        lock_guard<mutex> lock(idleMutex);
+        if (idleWorkers == 0) {
+            return true;
+        }
+    }
+    workReady.notify_one();
+    return true;
+}
+
+bool WorkStealingPool::popFrom(const size_t index, function<void()>& task) {
+    WorkerQueue& queue = *queues[index];
+    lock_guard<mutex> lock(queue.lock);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    queued.fetch_sub(1, memory_order_relaxed);
+    return true;
+}
+
+bool WorkStealingPool::findTask(const size_t self, function<void()>& task) {
+    if (popFrom(self, task)) {
+        return true;
+    }
+    // своя очередь пуста — крадём самую старую задачу у соседей
+    for (size_t i = 1; i < queues.size(); i++) {
+        if (popFrom((self + i) % queues.size(), task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(const size_t self) {
+    while (true) {
+        function<void()> task;
+        if (findTask(self, task)) {
+            try {
+                task();
+            } catch (const exception& e) {
+                // исключение задачи не должно уносить поток исполнителя
+                Logger::log(LogLevel::Error, string("Ошибка в задаче пула: ") + e.what());
+            } catch (...) {
+                Logger::log(LogLevel::Error, "Неизвестная ошибка в задаче пула");
+            }
+            continue;
+        }
+
+        unique_lock<mutex> lock(idleMutex);
+        if (stopping) {
+            return;
+        }
+        idleWorkers++;
+        workReady.wait(lock, [this] { return stopping || queued.load(memory_order_acquire) > 0; });
+        idleWorkers--;
+        if (stopping && queued.load(memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
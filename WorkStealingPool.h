@@ -0,0 +1,51 @@
+#ifndef PROVERKA_WORKSTEALINGPOOL_H
+#define PROVERKA_WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Исполнитель запросов с кражей работы: у каждого потока своя очередь,
+// свободный поток забирает самые старые задачи у соседей. Очереди
+// ограничены, и trySubmit возвращает false, когда места нет, — так
+// перегрузка видна сразу, а не растёт очередь и задержка.
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    const size_t queueCapacity;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<size_t> queued{0};
+
+    std::mutex idleMutex;
+    std::condition_variable workReady;
+    size_t idleWorkers = 0;
+    bool stopping = false;
+
+    bool popFrom(size_t index, std::function<void()>& task);
+    bool findTask(size_t self, std::function<void()>& task);
+    void workerLoop(size_t self);
+public:
+    // threads == 0 — по числу ядер
+    WorkStealingPool(size_t threads, size_t capacityPerThread);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    [[nodiscard]] bool trySubmit(std::function<void()> task);
+    [[nodiscard]] size_t size() const { return workers.size(); }
+};
+
+
+#endif //PROVERKA_WORKSTEALINGPOOL_H
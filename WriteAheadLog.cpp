@@ -0,0 +1,224 @@
+#include "WriteAheadLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+using namespace nlohmann;
+
+chrono::milliseconds WriteAheadLog::flushInterval(1);
+size_t WriteAheadLog::batchSize = 64;
+
+WriteAheadLog::WriteAheadLog(std::string filename) : path(std::move(filename)), fd(-1), records(0),
+                                                      durableRecords(0), durableSize(0),
+                                                      pendingRecords(0), lastTicket(0), durableTicket(0),
+                                                      flushing(false), broken(false), torn(false) {
+    fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть журнал " + path + ": " + strerror(errno));
+    }
+    durableSize = lseek(fd, 0, SEEK_END);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (fd >= 0) {
+        if (!pending.empty() && !broken) {
+            try {
+                writeBatch(pending);
+            } catch (const exception& e) {
+                cerr << e.what() << endl;
+            }
+        }
+        close(fd);
+    }
+}
+
+void WriteAheadLog::configure(chrono::milliseconds interval, size_t batch) {
+    flushInterval = interval;
+    batchSize = batch == 0 ? 1 : batch;
+}
+
+void WriteAheadLog::writeBatch(const std::string &batch) const {
+    size_t written = 0;
+    while (written < batch.size()) {
+        const ssize_t n = write(fd, batch.data() + written, batch.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("Ошибка записи в журнал " + path + ": " + strerror(errno));
+        }
+        written += n;
+    }
+    if (fdatasync(fd) < 0) {
+        throw runtime_error("Ошибка fsync журнала " + path + ": " + strerror(errno));
+    }
+}
+
+uint64_t WriteAheadLog::enqueue(const std::string &line) {
+    lock_guard<mutex> lock(queueMutex);
+    pending += line;
+    pendingRecords++;
+    records++;
+    if (pendingRecords >= batchSize) commitCv.notify_all();
+    return ++lastTicket;
+}
+
+uint64_t WriteAheadLog::currentTicket() {
+    lock_guard<mutex> lock(queueMutex);
+    return lastTicket;
+}
+
+uint64_t WriteAheadLog::durableThrough() {
+    lock_guard<mutex> lock(queueMutex);
+    return durableTicket;
+}
+
+bool WriteAheadLog::isBroken() {
+    lock_guard<mutex> lock(queueMutex);
+    return broken;
+}
+
+bool WriteAheadLog::isLost(const uint64_t ticket) const {
+    for (const auto& [from, to] : lost) {
+        if (ticket >= from && ticket <= to) return true;
+    }
+    return false;
+}
+
+uint64_t WriteAheadLog::logInsert(const json &doc) {
+    json record;
+    record["op"] = "insert";
+    record["doc"] = doc;
+    return enqueue(record.dump() + "\n");
+}
+
+uint64_t WriteAheadLog::logDelete(const std::string &id) {
+    json record;
+    record["op"] = "delete";
+    record["_id"] = id;
+    return enqueue(record.dump() + "\n");
+}
+
+void WriteAheadLog::waitDurable(uint64_t ticket) {
+    unique_lock<mutex> lock(queueMutex);
+    while (durableTicket < ticket && !broken && !isLost(ticket)) {
+        if (flushing) {
+            commitCv.wait(lock);
+            continue;
+        }
+
+        // становимся ведущим: ждём, пока подтянутся другие писатели
+        flushing = true;
+        commitCv.wait_for(lock, flushInterval, [this] { return pendingRecords >= batchSize; });
+
+        string batch;
+        batch.swap(pending);
+        const size_t batchRecords = pendingRecords;
+        pendingRecords = 0;
+        const uint64_t upTo = lastTicket;
+
+        lock.unlock();
+        bool ok = true;
+        try {
+            writeBatch(batch);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            ok = false;
+            // часть пакета могла попасть в файл; при загрузке её нельзя проиграть
+            if (ftruncate(fd, durableSize) < 0) {
+                cerr << "Не удалось обрезать журнал " << path << ": " << strerror(errno) << endl;
+                torn = true;
+            }
+        }
+        lock.lock();
+
+        flushing = false;
+        if (ok) {
+            durableTicket = upTo;
+            durableRecords += batchRecords;
+            durableSize += static_cast<off_t>(batch.size());
+        } else {
+            broken = true;
+        }
+        commitCv.notify_all();
+    }
+    if (durableTicket < ticket || isLost(ticket)) {
+        throw LogWriteError("Журнал " + path + " не сохранил запись");
+    }
+}
+
+void WriteAheadLog::replay(HashMap &map) {
+    ifstream file(path);
+    if (!file.is_open()) return;
+
+    string line;
+    size_t lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        if (line.empty()) continue;
+
+        json record;
+        try {
+            record = json::parse(line);
+        } catch (...) {
+            // недописанная последняя запись после аварийного завершения
+            cerr << "Журнал " << path << " обрезан на строке " << lineNumber << endl;
+            break;
+        }
+
+        const string op = record.value("op", "");
+        if (op == "insert") {
+            const string id = record["doc"]["_id"];
+            // запись могла уже попасть в снимок, если сбой случился между
+            // сохранением снимка и очисткой журнала
+            map.deleteById(id);
+            map.hashMapInsert(id, record["doc"]);
+        } else if (op == "delete") {
+            map.deleteById(record["_id"].get<string>());
+        }
+        records++;
+    }
+    durableRecords = records;
+}
+
+bool WriteAheadLog::discardLost() {
+    unique_lock<mutex> lock(queueMutex);
+    commitCv.wait(lock, [this] { return !flushing; });
+    if (!broken) return true;
+
+    if (lastTicket > durableTicket) lost.emplace_back(durableTicket + 1, lastTicket);
+    pending.clear();
+    pendingRecords = 0;
+    records = durableRecords;
+    // новые записи не должны подтверждать потерянные номера
+    durableTicket = lastTicket;
+    broken = torn;
+    commitCv.notify_all();
+    return !broken;
+}
+
+void WriteAheadLog::truncate() {
+    unique_lock<mutex> lock(queueMutex);
+    commitCv.wait(lock, [this] { return !flushing; });
+
+    // всё, что стоит в очереди, уже попало в снимок, кроме потерянного
+    // при ошибке записи: владелец откатил его до снимка
+    if (broken && lastTicket > durableTicket) lost.emplace_back(durableTicket + 1, lastTicket);
+    pending.clear();
+    pendingRecords = 0;
+    if (ftruncate(fd, 0) < 0) {
+        throw runtime_error("Не удалось очистить журнал " + path + ": " + strerror(errno));
+    }
+    records = 0;
+    durableRecords = 0;
+    durableSize = 0;
+    durableTicket = lastTicket;
+    broken = false;
+    torn = false;
+    commitCv.notify_all();
+}
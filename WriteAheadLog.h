@@ -0,0 +1,90 @@
+#ifndef PROVERKA_WRITEAHEADLOG_H
+#define PROVERKA_WRITEAHEADLOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+#include "hashMap.h"
+
+// Журнал изменений коллекции. Каждая вставка и удаление дописывается в конец
+// файла одной компактной JSON-строкой, поэтому запись стоит O(размер документа),
+// а не O(размер коллекции). При загрузке журнал проигрывается поверх снимка.
+//
+// Запись идёт через очередь коммитов: logInsert/logDelete только ставят запись
+// в очередь и выдают номер, а waitDurable дожидается, пока запись окажется на
+// диске. Первый ожидающий становится ведущим, собирает пакет из всех записей,
+// накопившихся за flushInterval (или до batchSize штук), и сбрасывает его одной
+// записью и одним fsync; остальные ожидающие получают подтверждение вместе с ним.
+//
+// Если пакет не удалось записать, файл обрезается до последней подтверждённой
+// записи, а журнал считается сломанным: все неподтверждённые записи потеряны,
+// и их waitDurable бросает LogWriteError. Владелец журнала откатывает их в
+// памяти и вызывает discardLost (или truncate после снимка), после чего журнал
+// снова принимает записи. Потерянные номера остаются потерянными навсегда.
+class LogWriteError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class WriteAheadLog {
+private:
+    static std::chrono::milliseconds flushInterval;
+    static size_t batchSize;
+
+    std::string path;
+    int fd;
+    size_t records;
+    size_t durableRecords;
+    off_t durableSize;
+
+    std::mutex queueMutex;
+    std::condition_variable commitCv;
+    std::string pending;
+    size_t pendingRecords;
+    uint64_t lastTicket;
+    uint64_t durableTicket;
+    bool flushing;
+    bool broken;
+    bool torn;  // файл не удалось обрезать после ошибки: в нём может быть часть пакета
+    std::vector<std::pair<uint64_t, uint64_t>> lost;  // номера записей, не попавших на диск
+
+    bool isLost(uint64_t ticket) const;
+
+    uint64_t enqueue(const std::string& line);
+    void writeBatch(const std::string& batch) const;
+public:
+    explicit WriteAheadLog(std::string filename);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    static void configure(std::chrono::milliseconds interval, size_t batch);
+
+    [[nodiscard]] size_t recordCount() const { return records; }
+    [[nodiscard]] uint64_t currentTicket();
+    // номер последней записи, которая точно на диске
+    [[nodiscard]] uint64_t durableThrough();
+    [[nodiscard]] bool isBroken();
+
+    uint64_t logInsert(const nlohmann::json& doc);
+    uint64_t logDelete(const std::string& id);
+    void waitDurable(uint64_t ticket);
+
+    void replay(HashMap& map);
+    // после отката в памяти: забывает неподтверждённые записи. false — файл
+    // остался в неизвестном состоянии, и починить журнал может только truncate
+    bool discardLost();
+    // всё, что было в журнале, уже в снимке
+    void truncate();
+};
+
+
+#endif //PROVERKA_WRITEAHEADLOG_H
@@ -0,0 +1,201 @@
+// Нагрузка из множества одновременных соединений (C10K): сравнение сервера
+// на epoll с прежним, где на каждое соединение заводился свой поток.
+//
+// Открывает N соединений, и каждое по кругу шлёт find и ждёт ответа.
+// Запросы без кадра, поэтому годится сервер любой ревизии. Перед замером
+// в коллекцию bench.c вставляются 100 документов.
+//
+// Сборка из корня репозитория:
+//   g++ -std=c++17 -O2 -I. bench/bench_connections.cpp -o bench_connections
+// Запуск: сервер слушает 127.0.0.1:8080, тогда
+//   ./bench_connections <соединений> <секунд> [pid сервера]
+// С pid печатаются число потоков и RSS сервера в простое и под нагрузкой.
+// Для сравнения тот же замер повторяется с сервером, собранным из последней
+// ревизии с потоком на соединение (до перехода на Reactor), например для
+// 100, 1000, 5000 и 10000 соединений.
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+    const int PORT = 8080;
+    const int SEED_DOCUMENTS = 100;
+    const string FIND_REQUEST =
+        R"({"database": "bench", "collection": "c", "operation": "find", "query": {"k": 1}})";
+
+    struct Client {
+        int fd = -1;
+        string input;
+        Clock::time_point sentAt;
+    };
+
+    int connectToServer() {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(PORT);
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // ответ — один объект JSON, клиент шлёт следующий запрос только после него
+    bool readReply(const int fd, string& reply) {
+        char buffer[65536];
+        reply.clear();
+        while (reply.empty() || reply.back() != '}') {
+            const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) return false;
+            reply.append(buffer, received);
+        }
+        return true;
+    }
+
+    string processStatus(const int pid, const string& key) {
+        ifstream status("/proc/" + to_string(pid) + "/status");
+        string line;
+        while (getline(status, line)) {
+            if (line.rfind(key, 0) == 0) return line;
+        }
+        return "";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Использование: " << argv[0] << " <соединений> <секунд> [pid сервера]" << endl;
+        return 1;
+    }
+    const int connections = stoi(argv[1]);
+    const double seconds = stod(argv[2]);
+    const int serverPid = argc > 3 ? stoi(argv[3]) : 0;
+
+    rlimit files{};
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    {
+        const int fd = connectToServer();
+        if (fd < 0) {
+            cerr << "Сервер на порту " << PORT << " недоступен" << endl;
+            return 1;
+        }
+        string reply;
+        for (int i = 0; i < SEED_DOCUMENTS; i++) {
+            const string insert = R"({"database": "bench", "collection": "c", "operation": "insert", "data": {"k": )"
+                                  + to_string(i % 10) + R"(, "v": )" + to_string(i) + "}}";
+            send(fd, insert.data(), insert.size(), MSG_NOSIGNAL);
+            if (!readReply(fd, reply)) break;
+        }
+        close(fd);
+    }
+
+    const int poller = epoll_create1(0);
+    vector<Client> clients(connections);
+    int failed = 0;
+    const auto connectStart = Clock::now();
+    for (int i = 0; i < connections; i++) {
+        const int fd = connectToServer();
+        if (fd < 0) {
+            failed++;
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        clients[i].fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+    }
+    const double connectSeconds = chrono::duration<double>(Clock::now() - connectStart).count();
+    usleep(500000);
+    const string idleRss = serverPid ? processStatus(serverPid, "VmRSS") : "";
+    const string idleThreads = serverPid ? processStatus(serverPid, "Threads") : "";
+
+    vector<double> latencies;
+    long replies = 0, busy = 0, errors = 0;
+    const auto start = Clock::now();
+    const auto finish = start + chrono::milliseconds(static_cast<long>(seconds * 1000));
+    for (auto& client : clients) {
+        if (client.fd < 0) continue;
+        client.sentAt = Clock::now();
+        if (send(client.fd, FIND_REQUEST.data(), FIND_REQUEST.size(), MSG_NOSIGNAL) < 0) errors++;
+    }
+
+    epoll_event events[1024];
+    char buffer[65536];
+    while (Clock::now() < finish) {
+        const int ready = epoll_wait(poller, events, 1024, 100);
+        for (int j = 0; j < ready; j++) {
+            Client& client = clients[events[j].data.u32];
+            const ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                if (received == 0 || errno != EAGAIN) {
+                    errors++;
+                    epoll_ctl(poller, EPOLL_CTL_DEL, client.fd, nullptr);
+                    close(client.fd);
+                    client.fd = -1;
+                }
+                continue;
+            }
+            client.input.append(buffer, received);
+            if (client.input.back() != '}') continue;
+
+            const auto now = Clock::now();
+            if (client.input.find("busy") != string::npos) {
+                busy++;
+            } else {
+                latencies.push_back(chrono::duration<double, milli>(now - client.sentAt).count());
+            }
+            replies++;
+            client.input.clear();
+            client.sentAt = now;
+            send(client.fd, FIND_REQUEST.data(), FIND_REQUEST.size(), MSG_NOSIGNAL);
+        }
+    }
+    const double elapsed = chrono::duration<double>(Clock::now() - start).count();
+    const string loadRss = serverPid ? processStatus(serverPid, "VmRSS") : "";
+
+    sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](const double q) {
+        if (latencies.empty()) return 0.0;
+        return latencies[min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))];
+    };
+    printf("соединений %d (не открылось %d, открытие %.2f с): %.0f запросов/с, p50 %.2f мс, p99 %.2f мс, "
+           "ошибок %ld, занято %ld\n",
+           connections, failed, connectSeconds, (replies - busy) / elapsed, percentile(0.5), percentile(0.99),
+           errors, busy);
+    if (serverPid) {
+        printf("сервер в простое: %s, %s; под нагрузкой: %s\n", idleThreads.c_str(), idleRss.c_str(), loadRss.c_str());
+    }
+    for (const auto& client : clients) {
+        if (client.fd >= 0) close(client.fd);
+    }
+    close(poller);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Конкуренция find с писателем при 1, 4, 16 и 64 потоках find и одном
+// писателе. Читатели ищут по хеш-индексу, писатель вставляет и ждёт коммита
+// журнала.
+//
+// Строка snapshot — путь, которым server.cpp идёт сейчас: find блокировок
+// коллекции не берёт и читает закреплённую версию, а писатель держит
+// getWriteLock() только на время вставки. Остальные строки исторические:
+// так было, пока find не читал снимки, — блокировку берёт сам замер, find
+// разделяемо (у std::mutex — целиком), вставка монопольно. Они показывают,
+// от чего ушли: std::mutex, std::shared_mutex и RwLock.
+//
+// Сборка из корня репозитория:
+//   g++ -std=c++17 -O2 -pthread -I. bench/bench_rwlock.cpp $(ls *.cpp | grep -v -e server -e client) -o bench_rwlock
+// Запуск: ./bench_rwlock [секунд на строку, 2]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Collection.h"
+#include "Database.h"
+#include "RwLock.h"
+
+using namespace std;
+
+namespace {
+    const string DATABASE = "bench_rwlock_db";
+    const int DOCUMENTS = 20000;
+    const int KEYS = 1000;
+
+    // find без блокировки, писатель под замком коллекции
+    struct Snapshot {};
+
+    template<typename Lock>
+    const char* lockName() {
+        if constexpr (is_same_v<Lock, Snapshot>) return "snapshot";
+        else if constexpr (is_same_v<Lock, mutex>) return "mutex";
+        else if constexpr (is_same_v<Lock, shared_mutex>) return "shared_mutex";
+        else return "RwLock";
+    }
+
+    template<typename Lock>
+    void run(Collection& coll, const int readers, const double seconds) {
+        [[maybe_unused]] Lock lock;
+        atomic<bool> stop{false};
+        atomic<long> finds{0}, inserts{0};
+        vector<thread> threads;
+        for (int r = 0; r < readers; r++) {
+            threads.emplace_back([&, r] {
+                long done = 0;
+                unsigned seed = r * 7919u;
+                while (!stop.load(memory_order_relaxed)) {
+                    seed = seed * 1103515245u + 12345u;
+                    const string query = "{\"k\": " + to_string(seed % KEYS) + "}";
+                    if constexpr (is_same_v<Lock, Snapshot>) {
+                        Database::findDoc(&coll, query);
+                    } else if constexpr (is_same_v<Lock, mutex>) {
+                        lock_guard<Lock> guard(lock);
+                        Database::findDoc(&coll, query);
+                    } else {
+                        shared_lock<Lock> guard(lock);
+                        Database::findDoc(&coll, query);
+                    }
+                    done++;
+                }
+                finds += done;
+            });
+        }
+        threads.emplace_back([&] {
+            long done = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                uint64_t ticket;
+                if constexpr (is_same_v<Lock, Snapshot>) {
+                    lock_guard<mutex> guard(coll.getWriteLock());
+                    Database::insertDoc(&coll, "{\"k\": " + to_string(KEYS) + ", \"v\": 1}");
+                    ticket = coll.commitTicket();
+                } else {
+                    unique_lock<Lock> guard(lock);
+                    Database::insertDoc(&coll, "{\"k\": " + to_string(KEYS) + ", \"v\": 1}");
+                    ticket = coll.commitTicket();
+                }
+                coll.waitDurable(ticket);
+                done++;
+            }
+            inserts += done;
+        });
+
+        this_thread::sleep_for(chrono::milliseconds(static_cast<long>(seconds * 1000)));
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        printf("  %-3d %-13s %10.0f %10.0f\n", readers, lockName<Lock>(), finds / seconds, inserts / seconds);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const double seconds = argc > 1 ? stod(argv[1]) : 2;
+
+    filesystem::remove_all(DATABASE);
+    {
+        Collection coll(DATABASE, "c");
+        coll.load();
+        for (int i = 0; i < DOCUMENTS; i++) {
+            Database::insertDoc(&coll, "{\"k\": " + to_string(i % KEYS) + ", \"v\": " + to_string(i) + "}");
+        }
+        Database::createIndex(&coll, "k", "hash");
+        coll.waitDurable(coll.commitTicket());
+
+        printf("  читателей, блокировка, find/с, вставок/с\n");
+        for (const int readers : {1, 4, 16, 64}) {
+            run<Snapshot>(coll, readers, seconds);
+            run<mutex>(coll, readers, seconds);
+            run<shared_mutex>(coll, readers, seconds);
+            run<RwLock>(coll, readers, seconds);
+        }
+    }
+    filesystem::remove_all(DATABASE);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Пропускная способность полного обхода коллекции в find (без индексов).
+//
+// Работает только через строковый API Database, поэтому собирается и на
+// ревизиях, где запрос ещё разбирался заново для каждого документа (до
+// появления Query): так сравниваются «до» и «после».
+//
+// Сборка из корня репозитория:
+//   g++ -std=c++17 -O2 -pthread -I. bench/bench_scan.cpp $(ls *.cpp | grep -v -e server -e client) -o bench_scan
+// Запуск: ./bench_scan [документов, 200000] [повторов, 20]
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Collection.h"
+#include "Database.h"
+
+using namespace std;
+
+namespace {
+    const string DATABASE = "bench_scan_db";
+    const char* const CITIES[] = {"Moscow", "Kazan", "Omsk", "Tomsk", "Perm", "Sochi", "Tver", "Ufa"};
+}
+
+int main(int argc, char* argv[]) {
+    const int documents = argc > 1 ? stoi(argv[1]) : 200000;
+    const int repeats = argc > 2 ? stoi(argv[2]) : 20;
+
+    filesystem::remove_all(DATABASE);
+    {
+        Collection coll(DATABASE, "users");
+        coll.load();
+        for (int i = 0; i < documents; i++) {
+            Database::insertDoc(&coll, "{\"name\": \"user" + to_string(i) + "\", \"age\": " + to_string(i % 100)
+                                       + ", \"city\": \"" + CITIES[i % 8] + "\", \"score\": " + to_string(i % 1000)
+                                       + ", \"tags\": [\"a\", \"b\"]}");
+        }
+
+        // запросы выбирают меньше процента документов: время уходит на обход, а не на ответ
+        const vector<pair<string, string>> queries = {
+            {"равенство двух полей", R"({"age": 42, "city": "Omsk"})"},
+            {"$gt", R"({"score": {"$gt": 995}})"},
+            {"$like с префиксом", R"({"name": {"$like": "user1234%"}})"},
+            {"$and из $in и равенства", R"({"$and": [{"age": {"$in": [7, 8]}}, {"city": "Moscow"}]})"},
+            {"$or", R"({"$or": [{"score": 1}, {"name": "user77"}]})"},
+        };
+        cout << "Документов: " << documents << ", повторов: " << repeats << endl;
+        for (const auto& [title, query] : queries) {
+            int found = 0;
+            const auto start = chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) {
+                found = Database::findDoc(&coll, query).first;
+            }
+            const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << "  " << title << ": " << static_cast<double>(documents) * repeats / seconds / 1e6
+                 << " млн документов/с, найдено " << found << endl;
+        }
+    }
+    filesystem::remove_all(DATABASE);
+    return 0;
+}
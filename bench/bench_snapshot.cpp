@@ -0,0 +1,59 @@
+// Время загрузки коллекции из бинарного снимка и из старого JSON-файла.
+//
+// Собирает таблицу из N документов, сохраняет её снимком (saveToFile) и
+// старым форматом — массивом JSON с отступом 4, как писал прежний
+// saveToFile, — и загружает каждый файл в пустую таблицу.
+//
+// Сборка из корня репозитория:
+//   g++ -std=c++17 -O2 -pthread -I. bench/bench_snapshot.cpp $(ls *.cpp | grep -v -e server -e client) -o bench_snapshot
+// Запуск: ./bench_snapshot [документов, 1000000]
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "hashMap.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace {
+    const string SNAPSHOT_PATH = "bench_snapshot.snap";
+    const string LEGACY_PATH = "bench_snapshot.json";
+
+    void measureLoad(const string& title, const string& path) {
+        const auto start = chrono::steady_clock::now();
+        HashMap map(3);
+        map.loadFromFile(path);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << title << ": " << filesystem::file_size(path) / (1024.0 * 1024.0) << " МБ, "
+             << map.getSize() << " документов за " << seconds << " с" << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const int documents = argc > 1 ? stoi(argv[1]) : 1000000;
+    {
+        HashMap source(3);
+        json legacy = json::array();
+        for (int i = 0; i < documents; i++) {
+            const string id = "doc" + to_string(i);
+            json doc = {{"_id", id}, {"name", "user" + to_string(i)}, {"age", i % 100},
+                        {"email", "user" + to_string(i) + "@example.com"}};
+            legacy.push_back(doc);
+            source.hashMapInsert(id, doc);
+        }
+        source.publish();
+        source.saveToFile(SNAPSHOT_PATH);
+        ofstream(LEGACY_PATH) << legacy.dump(4);
+    }
+
+    cout << "Документов: " << documents << endl;
+    measureLoad("JSON", LEGACY_PATH);
+    measureLoad("снимок", SNAPSHOT_PATH);
+
+    filesystem::remove(SNAPSHOT_PATH);
+    filesystem::remove(LEGACY_PATH);
+    return 0;
+}
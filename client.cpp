@@ -7,16 +7,21 @@
 #include <string>
 #include <chrono>
 #include <sstream>
+#include <vector>
 #include "nlohmann/json.hpp"
+#include "Frame.h"
 
 using namespace std;
 using json = nlohmann::json;
 
 int PORT;
-constexpr int BUFFER_SIZE = 8192;
 constexpr int SOCKET_TIMEOUT_SEC = 10;
 string SERVERIP;
 string nameDatabase;
+// номер следующего запроса; сервер возвращает его в поле "id" ответа
+uint64_t nextRequestId = 1;
+// 0 — диалоговый режим, иначе сколько запросов держать в полёте
+int pipelineDepth = 0;
 
 bool isValidIP(const string& ip) {
     sockaddr_in sa;
@@ -76,14 +81,13 @@ bool sendWithTimeout(int socket, const string& data) {
     return true;
 }
 
-// Функция для приема данных с таймаутом
-string receiveWithTimeout(int socket, char* buffer, int bufferSize) {
-    memset(buffer, 0, bufferSize);
-
+// Читает ровно size байт с таймаутом
+bool receiveExact(int socket, char* buffer, size_t size) {
+    size_t totalRead = 0;
     auto start = chrono::steady_clock::now();
 
-    while (true) {
-        int bytesRead = recv(socket, buffer, bufferSize - 1, 0);
+    while (totalRead < size) {
+        int bytesRead = recv(socket, buffer + totalRead, size - totalRead, 0);
 
         if (bytesRead < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -92,29 +96,148 @@ string receiveWithTimeout(int socket, char* buffer, int bufferSize) {
 
                 if (elapsed >= SOCKET_TIMEOUT_SEC) {
                     cerr << "[-] Таймаут ожидания ответа от сервера" << endl;
-                    return "";
+                    return false;
                 }
                 continue;
             }
 
             // Другая ошибка
             cerr << "[-] Ошибка получения данных: " << strerror(errno) << endl;
-            return "";
+            return false;
         }
 
         if (bytesRead == 0) {
             cerr << "[-] Сервер отключился" << endl;
-            return "";
+            return false;
+        }
+
+        totalRead += bytesRead;
+    }
+
+    return true;
+}
+
+// Принимает один кадр ответа: длину, затем JSON этой длины
+string receiveFrame(int socket) {
+    char header[FRAME_HEADER_SIZE];
+    if (!receiveExact(socket, header, FRAME_HEADER_SIZE)) {
+        return "";
+    }
+
+    string payload(readFrameLength(header), '\0');
+    if (!receiveExact(socket, payload.data(), payload.size())) {
+        return "";
+    }
+    return payload;
+}
+
+// Разбирает строку команды в запрос; при ошибке печатает причину
+bool buildRequest(const string& line, json& msg) {
+    istringstream iss(line);
+    string cmd, collection, jsonPart;
+    iss >> cmd >> collection;
+    getline(iss, jsonPart);
+
+    jsonPart.erase(0, jsonPart.find_first_not_of(" "));
+
+    msg["database"] = nameDatabase;
+    msg["collection"] = collection;
+
+    try {
+        if (cmd == "INSERT") {
+            msg["operation"] = "insert";
+            msg["data"] = json::parse(jsonPart);
+        } else if (cmd == "FIND") {
+            msg["operation"] = "find";
+            msg["query"] = json::parse(jsonPart);
+        } else if (cmd == "DELETE") {
+            msg["operation"] = "delete";
+            msg["query"] = json::parse(jsonPart);
+        } else if (cmd == "CREATE_INDEX" || cmd == "DROP_INDEX") {
+            // CREATE_INDEX <коллекция> <поле> [hash|range]
+            istringstream args(jsonPart);
+            string field, type;
+            args >> field >> type;
+            if (field.empty()) {
+                cout << "Не указано поле индекса" << endl;
+                return false;
+            }
+            msg["operation"] = cmd == "CREATE_INDEX" ? "createIndex" : "dropIndex";
+            msg["field"] = field;
+            msg["type"] = type.empty() ? "hash" : type;
+        } else {
+            cout << "Неизвестная команда: " << cmd << endl;
+            cout << "Доступные команды: INSERT, FIND, DELETE, CREATE_INDEX, DROP_INDEX" << endl;
+            return false;
+        }
+    } catch (const exception& e) {
+        cout << "Ошибка парсинга JSON: " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+// Конвейерный режим: читает все команды со стандартного ввода и держит
+// на сервере до pipelineDepth запросов без ответа. Ответы приходят в любом
+// порядке и сопоставляются с запросами по id.
+int runPipeline(int clientSocket) {
+    vector<string> frames;
+    string line;
+    while (getline(cin, line)) {
+        if (line.empty() || line == "exit") continue;
+        json msg;
+        if (!buildRequest(line, msg)) {
+            continue;
+        }
+        msg["id"] = nextRequestId++;
+        frames.push_back(encodeFrame(msg.dump()));
+    }
+
+    auto start = chrono::steady_clock::now();
+    size_t sent = 0;
+    size_t received = 0;
+    size_t failed = 0;
+    while (received < frames.size()) {
+        // досылаем, пока в полёте меньше pipelineDepth запросов
+        string batch;
+        while (sent < frames.size() && sent - received < static_cast<size_t>(pipelineDepth)) {
+            batch += frames[sent++];
+        }
+        if (!batch.empty() && !sendWithTimeout(clientSocket, batch)) {
+            cerr << "Не удалось отправить запрос на сервер" << endl;
+            return 1;
         }
 
-        return string(buffer, bytesRead);
+        string response = receiveFrame(clientSocket);
+        if (response.empty()) {
+            cerr << "Не удалось получить ответ от сервера" << endl;
+            return 1;
+        }
+        received++;
+        try {
+            json answer = json::parse(response);
+            if (answer.value("status", "") != "success") {
+                failed++;
+            }
+            cout << "[" << answer.value("id", json()).dump() << "] " << answer.dump() << endl;
+        } catch (const exception& e) {
+            failed++;
+            cout << "Ответ сервера (не JSON): " << response << endl;
+        }
     }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Выполнено запросов: " << received << " (с ошибкой: " << failed << ") за "
+         << seconds << " с, " << (seconds > 0 ? received / seconds : 0) << " запросов/с"
+         << ", в полёте до " << pipelineDepth << endl;
+    return 0;
 }
 
 int main(int argv, char* argc[]) {
     try {
         if (argv < 7) {
-            cerr << "Использование: " << argc[0] << " --host <IP> --port <PORT> --database <DB_NAME>" << endl;
+            cerr << "Использование: " << argc[0] << " --host <IP> --port <PORT> --database <DB_NAME>"
+                 << " [--pipeline <N>]" << endl;
             cerr << "Пример: " << argc[0] << " --host localhost --port 8080 --database mydb" << endl;
             return 1;
         }
@@ -172,6 +295,15 @@ int main(int argv, char* argc[]) {
             return 1;
         }
 
+        if (argv >= 9 && string(argc[7]) == "--pipeline") {
+            pipelineDepth = stoi(argc[8]);
+            if (pipelineDepth < 1) {
+                cerr << "Неверная глубина конвейера: " << pipelineDepth << endl;
+                close(clientSocket);
+                return 1;
+            }
+        }
+
         // Настройка адреса сервера
         sockaddr_in serverAddress{};
         serverAddress.sin_family = AF_INET;
@@ -218,11 +350,17 @@ int main(int argv, char* argc[]) {
         }
 
         cout << "Успешно подключено к серверу " << SERVERIP << ":" << PORT << endl;
+
+        if (pipelineDepth > 0) {
+            int result = runPipeline(clientSocket);
+            close(clientSocket);
+            return result;
+        }
+
         cout << "База данных: " << nameDatabase << endl;
         cout << "Таймаут операций: " << SOCKET_TIMEOUT_SEC << " секунд" << endl;
-        cout << "Введите команды (INSERT, FIND, DELETE) или 'exit' для выхода:" << endl;
+        cout << "Введите команды (INSERT, FIND, DELETE, CREATE_INDEX, DROP_INDEX) или 'exit' для выхода:" << endl;
 
-        char buffer[BUFFER_SIZE];
         string message;
 
         while (true) {
@@ -235,46 +373,25 @@ int main(int argv, char* argc[]) {
             }
             if (message.empty()) continue;
 
-            istringstream iss(message);
-            string cmd, collection, jsonPart;
-            iss >> cmd >> collection;
-            getline(iss, jsonPart);
-
-            jsonPart.erase(0, jsonPart.find_first_not_of(" "));
-
             json msg;
-            msg["database"] = nameDatabase;
-            msg["collection"] = collection;
-
-            try {
-                if (cmd == "INSERT") {
-                    msg["operation"] = "insert";
-                    msg["data"] = json::parse(jsonPart);
-                } else if (cmd == "FIND") {
-                    msg["operation"] = "find";
-                    msg["query"] = json::parse(jsonPart);
-                } else if (cmd == "DELETE") {
-                    msg["operation"] = "delete";
-                    msg["query"] = json::parse(jsonPart);
-                } else {
-                    cout << "Неизвестная команда: " << cmd << endl;
-                    cout << "Доступные команды: INSERT, FIND, DELETE" << endl;
-                    continue;
-                }
-            } catch (const exception& e) {
-                cout << "Ошибка парсинга JSON: " << e.what() << endl;
+            if (!buildRequest(message, msg)) {
                 continue;
             }
+            msg["id"] = nextRequestId++;
 
             message = msg.dump();
+            if (message.size() > MAX_REQUEST_FRAME) {
+                cout << "Запрос слишком большой: " << message.size() << " байт" << endl;
+                continue;
+            }
 
             // Отправляем запрос с таймаутом
-            if (!sendWithTimeout(clientSocket, message)) {
+            if (!sendWithTimeout(clientSocket, encodeFrame(message))) {
                 cerr << "Не удалось отправить запрос на сервер" << endl;
                 break;
             }
 
-            string response = receiveWithTimeout(clientSocket, buffer, BUFFER_SIZE);
+            string response = receiveFrame(clientSocket);
 
             if (response.empty()) {
                 cerr << "Не удалось получить ответ от сервера" << endl;
@@ -282,7 +399,11 @@ int main(int argv, char* argc[]) {
             }
 
             try {
-                cout << "Ответ сервера: " << json::parse(response).dump(4) << endl;
+                json answer = json::parse(response);
+                if (answer.value("id", json()) != msg["id"]) {
+                    cout << "Ответ пришёл не на тот запрос: ожидался id " << msg["id"] << endl;
+                }
+                cout << "Ответ сервера: " << answer.dump(4) << endl;
             } catch (const exception& e) {
                 cout << "Ответ сервера (не JSON): " << response << endl;
                 cout << "Ошибка парсинга JSON ответа: " << e.what() << endl;
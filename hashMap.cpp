@@ -1,6 +1,12 @@
 #include "hashMap.h"
 
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 #include "simlyList.h"
 #include <iostream>
@@ -10,151 +16,512 @@ using namespace nlohmann;
 
 HashMap::HashMapNode::HashMapNode() : list(nullptr){}
 
-HashMap::HashMap(const size_t& cap): capacity(cap), size(0) {
-    table = new HashMapNode[capacity];
-    for (size_t i = 0; i < capacity; i++) {
-        table[i].list = new SimplyList();
+// списки корзин создаются при первой записи, чтобы рост таблицы
+// не упирался в выделение миллионов пустых списков разом
+SimplyList& HashMap::HashMapNode::getList(SimplyList::Storage& storage) {
+    SimplyList* current = list.load(memory_order_relaxed);
+    if (current == nullptr) {
+        current = new SimplyList(storage);
+        list.store(current, memory_order_release);
     }
+    return *current;
 }
 
+HashMap::Tables::Tables(HashMapNode* newTable, const size_t newCapacity,
+                        HashMapNode* previous, const size_t previousCapacity) :
+                        table(newTable), capacity(newCapacity),
+                        oldTable(previous), oldCapacity(previousCapacity), migrateIndex(0) {}
+
+HashMap::HashMap(const size_t& cap): tables(new Tables(new HashMapNode[cap], cap, nullptr, 0)), size(0) {}
+
 HashMap::~HashMap() {
-    for (size_t i = 0; i < capacity; i++) {
-        delete table[i].list;
+    const Tables* t = current();
+    for (size_t i = 0; i < t->capacity; i++) {
+        delete t->table[i].list.load(memory_order_relaxed);
+    }
+    delete[] t->table;
+
+    // скопированные корзины старой таблицы уже отданы в epoch
+    if (t->oldTable != nullptr) {
+        for (size_t i = t->migrateIndex; i < t->oldCapacity; i++) {
+            delete t->oldTable[i].list.load(memory_order_relaxed);
+        }
+        delete[] t->oldTable;
     }
-    delete[] table;
+    delete t;
 }
 
 size_t HashMap::getCapacity() const {
-    return capacity;
+    return current()->capacity;
 }
 
-int HashMap::hashFunction(const std::string &str) const {
+unsigned long HashMap::hashOf(const std::string &str) {
     unsigned long hash = base;
 
     for (const auto& c : str) {
         hash ^= static_cast<unsigned char>(c);
         hash *= prime;
     }
-    return hash % capacity;
+    return hash;
 }
 
-void HashMap::hashMapInsert(const std::string &key,const json &value) {
-    if (static_cast<double>(size) / capacity >= 0.75) {
+int HashMap::hashFunction(const std::string &str) const {
+    return hashOf(str) % current()->capacity;
+}
+
+SimplyList* HashMap::oldBucket(const std::string &key) const {
+    const Tables* t = current();
+    if (t->oldTable == nullptr) return nullptr;
+    const size_t index = hashOf(key) % t->oldCapacity;
+    // скопированные корзины старой таблицы больше не меняются
+    if (index < t->migrateIndex.load(memory_order_acquire)) return nullptr;
+    return t->oldTable[index].list.load(memory_order_acquire);
+}
+
+const BinaryDocument& HashMap::hashMapInsert(const std::string &key,const json &value) {
+    return hashMapInsert(key, BinaryDocument(value, storage.fields));
+}
+
+const BinaryDocument& HashMap::hashMapInsert(const std::string &key, BinaryDocument &&value) {
+    if (current()->oldTable != nullptr) {
+        migrateBuckets(REHASH_STEP);
+    } else if (static_cast<double>(size) / current()->capacity >= 0.75) {
         rehash();
     }
-    const int index = hashFunction(key);
-    table[index].list->addHead(key, value);
+    const Tables* t = current();
+    const BinaryDocument& stored = t->table[hashOf(key) % t->capacity].getList(storage).addHead(key, std::move(value), epoch.next());
     size++;
+    return stored;
 }
 
 bool HashMap::deleteById(const std::string &id) {
-    if (table == nullptr || id.empty()) return false;
+    if (id.empty()) return false;
 
-    const int index = hashFunction(id);
+    if (current()->oldTable != nullptr) {
+        migrateBuckets(REHASH_STEP);
+    }
 
-    if (table[index].list == nullptr) {
-        return false;
+    // узел только помечается, из цепочки его вынет publish, когда
+    // не останется читателей, которые должны его видеть
+    const uint64_t version = epoch.next();
+    bool removed = false;
+    if (SimplyList* list = oldBucket(id); list != nullptr) {
+        removed = list->markDeleted(id, version);
     }
-    if (table[index].list->deleteByKey(id)) {
-        size--;
-        return true;
+    if (!removed) {
+        const Tables* t = current();
+        SimplyList* list = t->table[hashOf(id) % t->capacity].list.load(memory_order_relaxed);
+        removed = list != nullptr && list->markDeleted(id, version);
+    }
+    if (!removed) return false;
+
+    unlinkQueue.emplace_back(id, version);
+    size--;
+    return true;
+}
+
+void HashMap::publish() {
+    epoch.publish();
+    unlinkRemoved();
+    epoch.reclaim();
+}
+
+void HashMap::unlinkRemoved() {
+    if (unlinkQueue.empty()) return;
+    // версии в очереди не убывают
+    const uint64_t oldest = epoch.oldestReader();
+    while (!unlinkQueue.empty() && unlinkQueue.front().second <= oldest) {
+        const string& id = unlinkQueue.front().first;
+        SimplyList* list = oldBucket(id);
+        auto node = list != nullptr ? list->unlinkDeleted(id) : nullptr;
+        if (node == nullptr) {
+            const Tables* t = current();
+            list = t->table[hashOf(id) % t->capacity].list.load(memory_order_relaxed);
+            if (list != nullptr) node = list->unlinkDeleted(id);
+        }
+        // узла может не быть: удалённое не копируется при переносе корзины
+        if (node != nullptr) epoch.retire(node);
+        unlinkQueue.pop_front();
     }
-    return false;
 }
 
 
 
 MyVector<pair<string,json>> HashMap::items() const {
     MyVector<std::pair<std::string, json>> result;
-    for (size_t i = 0; i < capacity; i++) {
-        for (const auto& item : table[i].list->items()) {
-            result.push_backV(item);
-        }
-    }
+    result.reserve(size);
+    forEach([this, &result](const string& id, const BinaryDocument& doc) {
+        result.emplace_backV(id, doc.toJson(storage.fields));
+    });
     return result;
 }
 
 
 void HashMap::print() const {
-    if (table == nullptr) return;
-    cout << "Размер: " << size << "/" << capacity << endl;
-    for (size_t i = 0; i < capacity; i++) {
-        if (table[i].list == nullptr) {
+    const Tables* t = current();
+    cout << "Размер: " << size << "/" << t->capacity << endl;
+    cout << "Узлов: " << storage.nodes.liveObjects() << ", документов: " << storage.documents.liveObjects()
+         << ", блоков пула: " << storage.nodes.slabCount() + storage.documents.slabCount() << " ("
+         << (storage.nodes.reservedBytes() + storage.documents.reservedBytes()) / 1024 << " КБ)" << endl;
+    for (size_t i = 0; i < t->capacity; i++) {
+        if (const SimplyList* list = t->table[i].peek(); list == nullptr) {
             cout << "[" << i << " [NULL]" << endl;
         } else {
             cout << "[" << i << "] ";
-            table[i].list->printList();
+            list->printList();
+        }
+    }
+    if (t->oldTable != nullptr) {
+        const size_t migrated = t->migrateIndex;
+        cout << "Старая таблица, не перенесено: " << t->oldCapacity - migrated << "/" << t->oldCapacity << endl;
+        for (size_t i = migrated; i < t->oldCapacity; i++) {
+            if (const SimplyList* list = t->oldTable[i].peek(); list == nullptr) {
+                cout << "[" << i << " [NULL]" << endl;
+            } else {
+                cout << "[" << i << "] ";
+                list->printList();
+            }
         }
     }
 }
 
 void HashMap::saveToFile(const string& filename) const {
-    json data = json::array();
-    auto allItems = items();
-    for (const auto& item : allItems) {
-        data.push_back(item.second);
+    ofstream file(filename, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        throw runtime_error("Не удалось открыть файл " + filename);
     }
 
-    ofstream file(filename);
-    file << data.dump(4);
+    const uint64_t count = size;
+    file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    file.write(reinterpret_cast<const char*>(&SNAPSHOT_VERSION), sizeof(SNAPSHOT_VERSION));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    const uint32_t names = storage.fields.size();
+    file.write(reinterpret_cast<const char*>(&names), sizeof(names));
+    for (uint32_t i = 0; i < names; i++) {
+        const string& name = storage.fields.name(i);
+        const auto length = static_cast<uint32_t>(name.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(name.data(), length);
+    }
+
+    // документы пишутся как есть, без перевода в другой формат
+    forEach([&](const string&, const BinaryDocument& doc) {
+        const auto length = static_cast<uint32_t>(doc.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(doc.bytes(), length);
+    });
+    if (!file) {
+        throw runtime_error("Ошибка записи в файл " + filename);
+    }
 }
 
-void HashMap::loadFromFile(const std::string &filename) {
-    json docs = json::array();
-    if (ifstream file(filename); file.is_open()) {
-        try {
-            file >> docs;
-        } catch (...) {
-            cerr << "Файл повреждён — начинаем с нуля." << endl;
+static constexpr size_t RELEASE_CHUNK = 8 << 20;
+
+// Файл, отображённый в память только для чтения
+struct MappedFile {
+    const char* data = nullptr;
+    size_t length = 0;
+
+    explicit MappedFile(const string& filename) {
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(addr);
+                length = st.st_size;
+            }
         }
-        file.close();
+        close(fd);
     }
-    for (const auto& doc : docs) {
-        string id = doc["_id"];
-        hashMapInsert(id, doc);
+    ~MappedFile() {
+        if (data != nullptr) munmap(const_cast<char*>(data), length);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// SAX-обработчик для старого формата: собирает по одному документу верхнего
+// массива и сразу переносит его в таблицу, весь массив в памяти не строится
+struct StreamingLoader {
+    HashMap& map;
+    json current;
+    vector<json*> stack;
+    json* objectElement = nullptr;
+    bool inTopArray = false;
+
+    explicit StreamingLoader(HashMap& target) : map(target) {}
+
+    json* handleValue(json&& value) {
+        if (stack.empty()) return nullptr;
+        json& parent = *stack.back();
+        if (parent.is_array()) {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+        *objectElement = std::move(value);
+        return objectElement;
     }
-}
-
-void HashMap::rehash() {
-    const size_t oldCapacity = capacity;
-    HashMapNode* oldTable = table;
 
-    capacity = capacity * 2 + 1;
-    size = 0;
+    bool null() { handleValue(nullptr); return true; }
+    bool boolean(bool val) { handleValue(val); return true; }
+    bool number_integer(json::number_integer_t val) { handleValue(val); return true; }
+    bool number_unsigned(json::number_unsigned_t val) { handleValue(val); return true; }
+    bool number_float(json::number_float_t val, const string&) { handleValue(val); return true; }
+    bool string(json::string_t& val) { handleValue(std::move(val)); return true; }
+    bool binary(json::binary_t& val) { handleValue(json::binary(std::move(val))); return true; }
+
+    bool start_object(size_t) {
+        if (stack.empty()) {
+            if (!inTopArray) return false;
+            current = json::object();
+            stack.push_back(&current);
+        } else {
+            stack.push_back(handleValue(json::object()));
+        }
+        return true;
+    }
+    bool key(json::string_t& val) {
+        objectElement = &(*stack.back())[val];
+        return true;
+    }
+    bool end_object() {
+        stack.pop_back();
+        if (stack.empty()) {
+            if (const auto it = current.find("_id"); it != current.end() && it->is_string()) {
+                const std::string id = *it;
+                map.hashMapInsert(id, current);
+            }
+        }
+        return true;
+    }
+    bool start_array(size_t) {
+        if (stack.empty()) {
+            if (inTopArray) return true; // массив вместо документа пропускаем
+            inTopArray = true;
+            return true;
+        }
+        stack.push_back(handleValue(json::array()));
+        return true;
+    }
+    bool end_array() {
+        if (!stack.empty()) stack.pop_back();
+        return true;
+    }
+    bool parse_error(size_t, const std::string&, const json::exception&) { return false; }
+};
 
-    table = new HashMapNode[capacity];
-    for (size_t i = 0; i < capacity; i++) {
-        table[i].list = new SimplyList();
+void HashMap::loadJson(const char* begin, const char* end) {
+    StreamingLoader loader(*this);
+    if (!json::sax_parse(begin, end, &loader)) {
+        cerr << "Файл повреждён — загружено документов: " << size << endl;
     }
+}
 
-    for (size_t i = 0; i < oldCapacity; i++) {
-        const SimplyList* currentList = oldTable[i].list;
-        auto current = currentList->getHead();
+void HashMap::loadSnapshot(const char* begin, const char* end, const std::string &filename) {
+    const char* pos = begin + sizeof(SNAPSHOT_MAGIC);
 
-        while (current != nullptr) {
-            int newIndex = hashFunction(current->id_);
-            table[newIndex].list->addHead(current->id_, current->data);
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(version) + sizeof(count))) {
+        cerr << "Снимок " << filename << " обрезан — начинаем с нуля." << endl;
+        return;
+    }
+    memcpy(&version, pos, sizeof(version));
+    pos += sizeof(version);
+    memcpy(&count, pos, sizeof(count));
+    pos += sizeof(count);
+    if (version != SNAPSHOT_VERSION) {
+        cerr << "Неизвестная версия снимка " << filename << " — начинаем с нуля." << endl;
+        return;
+    }
 
-            size++;
-            current = current->next;
+    // Пока номера полей снимка совпадают с номерами в словаре таблицы
+    // (а при загрузке в пустую таблицу так и есть), документы берутся как
+    // есть. Иначе они перекодируются через json.
+    FieldDictionary snapshotFields;
+    bool sameFields = true;
+    uint32_t names = 0;
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(names))) {
+        cerr << "Снимок " << filename << " обрезан — начинаем с нуля." << endl;
+        return;
+    }
+    memcpy(&names, pos, sizeof(names));
+    pos += sizeof(names);
+    for (uint32_t i = 0; i < names; i++) {
+        uint32_t length = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(length))) {
+            cerr << "Снимок " << filename << " обрезан — начинаем с нуля." << endl;
+            return;
+        }
+        memcpy(&length, pos, sizeof(length));
+        pos += sizeof(length);
+        if (end - pos < static_cast<ptrdiff_t>(length)) {
+            cerr << "Снимок " << filename << " обрезан — начинаем с нуля." << endl;
+            return;
         }
+        const string_view name(pos, length);
+        const uint32_t local = storage.fields.intern(name);
+        sameFields = snapshotFields.intern(name) == local && sameFields;
+        pos += length;
     }
+    const uint32_t idField = storage.fields.find("_id");
+    reserve(size + count);
+
+    // прочитанные страницы отдаём обратно, чтобы отображение не висело в RSS
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const char* released = begin;
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (static_cast<size_t>(pos - released) >= RELEASE_CHUNK) {
+            const char* upTo = begin + (static_cast<size_t>(pos - begin) & ~(pageSize - 1));
+            madvise(const_cast<char*>(released), upTo - released, MADV_DONTNEED);
+            released = upTo;
+        }
 
-    for (size_t i = 0; i < oldCapacity; i++) {
-        delete oldTable[i].list;
+        uint32_t length = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(length))) {
+            cerr << "Снимок " << filename << " обрезан после " << i << " документов" << endl;
+            return;
+        }
+        memcpy(&length, pos, sizeof(length));
+        pos += sizeof(length);
+        if (end - pos < static_cast<ptrdiff_t>(length)) {
+            cerr << "Снимок " << filename << " обрезан после " << i << " документов" << endl;
+            return;
+        }
+        try {
+            if (sameFields) {
+                BinaryDocument doc = BinaryDocument::fromBytes(pos, length, storage.fields);
+                const BinaryDocument::Value id = doc.find(idField);
+                if (!id || !id.isString()) throw runtime_error("нет _id");
+                hashMapInsert(string(id.string()), std::move(doc));
+            } else {
+                const json doc = BinaryDocument::fromBytes(pos, length, snapshotFields).toJson(snapshotFields);
+                hashMapInsert(doc.at("_id").get<string>(), doc);
+            }
+        } catch (const exception& e) {
+            cerr << "Повреждённый документ в снимке " << filename << ": " << e.what() << endl;
+        }
+        pos += length;
     }
+}
 
-    delete[] oldTable;
+void HashMap::loadFromFile(const std::string &filename) {
+    const MappedFile file(filename);
+    if (file.data == nullptr) return;
+
+    const char* end = file.data + file.length;
+    if (file.length >= sizeof(SNAPSHOT_MAGIC) && memcmp(file.data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0) {
+        loadSnapshot(file.data, end, filename);
+    } else {
+        // старый формат: массив JSON
+        loadJson(file.data, end);
+    }
+}
 
+void HashMap::reserve(size_t count) {
+    size_t newCapacity = current()->capacity;
+    while (static_cast<double>(count) / newCapacity >= 0.75) {
+        newCapacity = newCapacity * 2 + 1;
+    }
+    if (newCapacity != current()->capacity) {
+        resizeTable(newCapacity);
+    }
 }
 
-std::pair<std::string, std::string> HashMap::searchByKey(const std::string &key) const {
-    if (table == nullptr) return {"", ""};
+void HashMap::replaceTables(Tables* next) {
+    Tables* previous = current();
+    tables.store(next, memory_order_release);
+    epoch.retire(previous);
+}
+
+void HashMap::rehash() {
+    finishRehash();
+
+    const Tables* t = current();
+    const size_t newCapacity = t->capacity * 2 + 1;
+    replaceTables(new Tables(new HashMapNode[newCapacity], newCapacity, t->table, t->capacity));
+    migrateBuckets(REHASH_STEP);
+}
+
+// Копирует узлы списка в другую таблицу. Удалённое, чего уже не видит
+// ни один читатель, не копируется.
+void HashMap::copyList(const SimplyList &list, HashMapNode* target, const size_t targetCapacity, const size_t origin) {
+    uint64_t oldest = 0;
+    list.forEachNode([&](const auto& node) {
+        if (const uint64_t removed = node.deleted.load(memory_order_relaxed); removed != 0) {
+            if (oldest == 0) oldest = epoch.oldestReader();
+            if (removed <= oldest) return;
+        }
+        target[hashOf(node.key()) % targetCapacity].getList(storage).addCopy(node, origin);
+    });
+}
 
-    size_t index = hashFunction(key);
-    if (table[index].list == nullptr) return {"", ""};
+void HashMap::migrateBuckets(size_t count) {
+    Tables* t = current();
+    while (t->oldTable != nullptr && count-- > 0) {
+        const size_t index = t->migrateIndex.load(memory_order_relaxed);
+        if (SimplyList* currentList = t->oldTable[index].list.load(memory_order_relaxed)) {
+            copyList(*currentList, t->table, t->capacity, index);
+            epoch.retire(currentList);
+        }
+        // копии публикуются раньше, чем читатели перестанут заходить в старую корзину
+        t->migrateIndex.store(index + 1, memory_order_release);
+
+        if (index + 1 == t->oldCapacity) {
+            epoch.retireArray(t->oldTable);
+            replaceTables(new Tables(t->table, t->capacity, nullptr, 0));
+            return;
+        }
+    }
+}
 
-    return table[index].list->searchByKey(key);
+void HashMap::finishRehash() {
+    migrateBuckets(current()->oldCapacity);
 }
 
+void HashMap::resizeTable(size_t newCapacity) {
+    finishRehash();
 
+    const Tables* t = current();
+    auto* table = new HashMapNode[newCapacity];
+    for (size_t i = 0; i < t->capacity; i++) {
+        SimplyList* currentList = t->table[i].list.load(memory_order_relaxed);
+        if (currentList == nullptr) continue;
+        copyList(*currentList, table, newCapacity, SimplyList::NO_ORIGIN);
+        epoch.retire(currentList);
+    }
+    epoch.retireArray(t->table);
+    replaceTables(new Tables(table, newCapacity, nullptr, 0));
+}
+
+std::pair<std::string, std::string> HashMap::searchByKey(const std::string &key) const {
+    if (const BinaryDocument* doc = findById(key)) {
+        return {key, doc->toJson(storage.fields).dump(4)};
+    }
+    return {"", ""};
+}
+
+const BinaryDocument* HashMap::findById(const std::string &id) const {
+    return findByIdAt(id, epoch.current());
+}
+
+const BinaryDocument* HashMap::findByIdAt(const std::string &id, const uint64_t version) const {
+    const Tables* t = current();
+    if (t->oldTable != nullptr) {
+        const size_t index = hashOf(id) % t->oldCapacity;
+        // в старую корзину ничего не добавляется, и её копирование не мешает
+        // искать в ней; если её скопировали раньше, документ уже в новой таблице
+        if (index >= t->migrateIndex.load(memory_order_acquire)) {
+            if (const SimplyList* list = t->oldTable[index].peek()) {
+                if (const BinaryDocument* doc = list->findByKeyAt(id, version)) return doc;
+            }
+        }
+    }
+    const SimplyList* list = t->table[hashOf(id) % t->capacity].peek();
+    return list == nullptr ? nullptr : list->findByKeyAt(id, version);
+}
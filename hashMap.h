@@ -1,7 +1,11 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <string>
+#include "Epoch.h"
 #include "simlyList.h"
 #include "myVector.h"
 
@@ -9,33 +13,128 @@
 const unsigned long base = 2166136261;
 const unsigned long prime = 16777619;
 
+// Заголовок бинарного снимка: сигнатура, версия и число документов.
+// Дальше словарь имён полей (uint32 число имён, каждое имя с uint32 длиной)
+// и байты документов (BinaryDocument), каждый с 4-байтовой длиной впереди.
+// Коллекции, сохранённые раньше, лежат в JSON и читаются отдельно.
+const char SNAPSHOT_MAGIC[4] = {'H', 'M', 'S', 'N'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+// Рехеширование постепенное: при росте старая таблица остаётся рядом с новой,
+// и каждая вставка или удаление переносит в новую не больше REHASH_STEP корзин.
+// Пока перенос не закончен, поиск смотрит в обе таблицы.
+//
+// Меняет таблицу один писатель, а читатели идут по ней без замков, на версии,
+// закреплённой через Epoch::Reader. Вставка и удаление помечаются версией
+// getEpoch().next() и становятся видны все сразу после publish. Поэтому при
+// переносе узлы не перевешиваются, а копируются: старая корзина остаётся
+// целой для тех, кто по ней идёт, и освобождается через Epoch, как и
+// вынутые из цепочек удалённые узлы.
 class HashMap {
 private:
     struct HashMapNode {
-        SimplyList* list;
+        std::atomic<SimplyList*> list;
 
         HashMapNode();
+        SimplyList& getList(SimplyList::Storage& storage);
+        [[nodiscard]] const SimplyList* peek() const { return list.load(std::memory_order_acquire); }
+    };
+    // Таблицы в том виде, в каком их видит читатель. Заменяются целиком
+    // в начале и в конце рехеширования.
+    struct Tables {
+        HashMapNode* table;
+        size_t capacity;
+        HashMapNode* oldTable;
+        size_t oldCapacity;
+        std::atomic<size_t> migrateIndex;  // корзины старой таблицы до этой уже скопированы
+
+        Tables(HashMapNode* newTable, size_t newCapacity, HashMapNode* previous, size_t previousCapacity);
     };
-    HashMapNode* table;
-    size_t capacity;
+    static constexpr size_t REHASH_STEP = 4;
+
+    std::atomic<Tables*> tables;
     size_t size;
+    // пулы объявлены раньше epoch: отложенные узлы освобождаются в них
+    SimplyList::Storage storage;
+    Epoch epoch;
+    // удалённые, которых ещё надо вынуть из цепочек: id и версия удаления
+    std::deque<std::pair<std::string, uint64_t>> unlinkQueue;
+
+    [[nodiscard]] Tables* current() const { return tables.load(std::memory_order_acquire); }
+    [[nodiscard]] static unsigned long hashOf(const std::string& str);
+    // ещё не скопированная корзина старой таблицы, в которую попадает key
+    [[nodiscard]] SimplyList* oldBucket(const std::string& key) const;
+    void copyList(const SimplyList& list, HashMapNode* target, size_t targetCapacity, size_t origin);
+    void replaceTables(Tables* next);
+    void migrateBuckets(size_t count);
+    void finishRehash();
+    void resizeTable(size_t newCapacity);
+    void unlinkRemoved();
+    void loadJson(const char* begin, const char* end);
+    void loadSnapshot(const char* begin, const char* end, const std::string& filename);
 public:
     explicit HashMap(const size_t& cap);
     ~HashMap();
 
+    HashMap(const HashMap&) = delete;
+    HashMap& operator=(const HashMap&) = delete;
+
     [[nodiscard]] size_t getCapacity() const;
+    [[nodiscard]] size_t getSize() const { return size; }
+    [[nodiscard]] bool isRehashing() const { return current()->oldTable != nullptr; }
+    [[nodiscard]] const Epoch& getEpoch() const { return epoch; }
+    // имена полей документов; добавлять новые может только писатель
+    [[nodiscard]] const FieldDictionary& getFields() const { return storage.fields; }
+    [[nodiscard]] FieldDictionary& getFields() { return storage.fields; }
+    void reserve(size_t count);
 
     [[nodiscard]] int hashFunction(const std::string& str) const;
-    void hashMapInsert(const std::string& key,const nlohmann::json& value);
+    // возвращают документ в том виде, в каком он лежит в таблице
+    const BinaryDocument& hashMapInsert(const std::string& key, const nlohmann::json& value);
+    const BinaryDocument& hashMapInsert(const std::string& key, BinaryDocument&& value);
     bool deleteById(const std::string& id);
+    // делает видимыми все изменения после прошлого publish и освобождает
+    // то, что больше никому не видно
+    void publish();
 
     [[nodiscard]]MyVector<std::pair<std::string, nlohmann::json>> items() const;
 
+    // Обход документов, видимых в версии version, на месте:
+    // visit(const std::string& id, const BinaryDocument& doc). Читатель
+    // держит Epoch::Reader с этой версией, писатель может обходить без него.
+    template<typename F>
+    void forEachAt(const uint64_t version, F&& visit) const {
+        const Tables* t = current();
+        size_t migrated = 0;
+        if (t->oldTable != nullptr) {
+            migrated = t->migrateIndex.load(std::memory_order_acquire);
+            for (size_t i = migrated; i < t->oldCapacity; i++) {
+                if (const SimplyList* list = t->oldTable[i].peek()) list->forEachAt(version, visit);
+            }
+        }
+        for (size_t i = 0; i < t->capacity; i++) {
+            const SimplyList* list = t->table[i].peek();
+            if (list == nullptr) continue;
+            list->forEachNode([&](const auto& node) {
+                // копии корзин, которые уже пройдены в старой таблице
+                if (t->oldTable != nullptr && node.origin != SimplyList::NO_ORIGIN && node.origin >= migrated) return;
+                if (node.visibleAt(version)) visit(node.key(), node.value());
+            });
+        }
+    }
+    // обход последней опубликованной версии
+    template<typename F>
+    void forEach(F&& visit) const {
+        forEachAt(epoch.current(), visit);
+    }
+
     void saveToFile(const std::string& filename) const;
     void loadFromFile(const std::string& filename);
     void print() const;
     void rehash();
     std::pair<std::string, std::string> searchByKey(const std::string& key) const;
+    [[nodiscard]] const BinaryDocument* findById(const std::string& id) const;
+    [[nodiscard]] const BinaryDocument* findByIdAt(const std::string& id, uint64_t version) const;
 
 };
 
@@ -1,46 +1,187 @@
 #ifndef INC_1PRAKA_MYVECTOR_H
 #define INC_1PRAKA_MYVECTOR_H
 
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-
-template<typename T>
+// Динамический массив. Память выделяется без конструирования элементов,
+// элементы создаются на месте при добавлении. Для тривиально копируемых T
+// со стандартным аллокатором буфер растёт через realloc, а копируется
+// через memcpy; выбор делается при компиляции.
+template<typename T, typename Allocator = std::allocator<T>>
 class MyVector {
 private:
+    using Traits = std::allocator_traits<Allocator>;
+    static constexpr bool USE_REALLOC = std::is_trivially_copyable_v<T> &&
+                                        std::is_same_v<Allocator, std::allocator<T>>;
+    static constexpr size_t MIN_CAPACITY = 4;
+
     T* data;
     size_t capacity;
     size_t sizeV;
+    Allocator alloc;
 
-    void resizeV() {
-        size_t newCapacity = capacity;
-        if (newCapacity == 0) newCapacity = 1;
-        else newCapacity = capacity * 2;
-
-        T* newData = new T[newCapacity];
-
-        for (size_t i = 0; i < sizeV; i++) {
-            newData[i] = std::move(data[i]);
+    T* allocate(size_t count) {
+        if (count == 0) return nullptr;
+        if constexpr (USE_REALLOC) {
+            void* memory = std::malloc(count * sizeof(T));
+            if (memory == nullptr) throw std::bad_alloc();
+            return static_cast<T*>(memory);
+        } else {
+            return Traits::allocate(alloc, count);
+        }
+    }
+    void deallocate(T* memory, size_t count) {
+        if (memory == nullptr) return;
+        if constexpr (USE_REALLOC) {
+            std::free(memory);
+        } else {
+            Traits::deallocate(alloc, memory, count);
+        }
+    }
+    void destroyAll() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_t i = 0; i < sizeV; i++) Traits::destroy(alloc, data + i);
         }
+        sizeV = 0;
+    }
 
-        delete[] data;
-        data = newData;
+    // переносит элементы в буфер на newCapacity мест
+    void relocate(size_t newCapacity) {
+        if constexpr (USE_REALLOC) {
+            if (newCapacity == 0) {
+                std::free(data);
+                data = nullptr;
+            } else {
+                void* memory = std::realloc(data, newCapacity * sizeof(T));
+                if (memory == nullptr) throw std::bad_alloc();
+                data = static_cast<T*>(memory);
+            }
+        } else {
+            T* newData = allocate(newCapacity);
+            size_t moved = 0;
+            try {
+                for (; moved < sizeV; moved++) {
+                    Traits::construct(alloc, newData + moved, std::move_if_noexcept(data[moved]));
+                }
+            } catch (...) {
+                for (size_t i = 0; i < moved; i++) Traits::destroy(alloc, newData + i);
+                deallocate(newData, newCapacity);
+                throw;
+            }
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                for (size_t i = 0; i < sizeV; i++) Traits::destroy(alloc, data + i);
+            }
+            deallocate(data, capacity);
+            data = newData;
+        }
         capacity = newCapacity;
+    }
+
+    void resizeV() {
+        relocate(capacity < MIN_CAPACITY ? MIN_CAPACITY : capacity * 2);
     };
+
+    void copyFrom(const MyVector& other) {
+        data = allocate(other.sizeV);
+        capacity = other.sizeV;
+        if constexpr (USE_REALLOC) {
+            if (other.sizeV != 0) std::memcpy(data, other.data, other.sizeV * sizeof(T));
+            sizeV = other.sizeV;
+        } else {
+            try {
+                for (; sizeV < other.sizeV; sizeV++) {
+                    Traits::construct(alloc, data + sizeV, other.data[sizeV]);
+                }
+            } catch (...) {
+                destroyAll();
+                deallocate(data, capacity);
+                throw;
+            }
+        }
+    }
 public:
     MyVector(): data(nullptr), capacity(0), sizeV(0){}
+    explicit MyVector(const Allocator& allocator): data(nullptr), capacity(0), sizeV(0), alloc(allocator){}
+
+    ~MyVector() {
+        destroyAll();
+        deallocate(data, capacity);
+    }
+
+    MyVector(const MyVector& other):
+        data(nullptr), capacity(0), sizeV(0),
+        alloc(Traits::select_on_container_copy_construction(other.alloc)) {
+        copyFrom(other);
+    }
+    MyVector(MyVector&& other) noexcept:
+        data(other.data), capacity(other.capacity), sizeV(other.sizeV), alloc(std::move(other.alloc)) {
+        other.data = nullptr;
+        other.capacity = 0;
+        other.sizeV = 0;
+    }
+    MyVector& operator=(const MyVector& other) {
+        if (this != &other) {
+            MyVector copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+    MyVector& operator=(MyVector&& other) noexcept {
+        if (this != &other) {
+            destroyAll();
+            deallocate(data, capacity);
+            data = std::exchange(other.data, nullptr);
+            capacity = std::exchange(other.capacity, 0);
+            sizeV = std::exchange(other.sizeV, 0);
+            alloc = std::move(other.alloc);
+        }
+        return *this;
+    }
+
+    void swap(MyVector& other) noexcept {
+        std::swap(data, other.data);
+        std::swap(capacity, other.capacity);
+        std::swap(sizeV, other.sizeV);
+        std::swap(alloc, other.alloc);
+    }
 
-    ~MyVector() {delete[] data;}
+    void reserve(size_t count) {
+        if (count > capacity) relocate(count);
+    }
+    void shrink_to_fit() {
+        if (sizeV < capacity) relocate(sizeV);
+    }
+    void clear() { destroyAll(); }
 
+    template<typename... Args>
+    T& emplace_backV(Args&&... args) {
+        if (sizeV >= capacity) {
+            // аргументы могут ссылаться на элементы этого же массива,
+            // поэтому элемент создаётся до переезда
+            T value(std::forward<Args>(args)...);
+            resizeV();
+            Traits::construct(alloc, data + sizeV, std::move(value));
+        } else {
+            Traits::construct(alloc, data + sizeV, std::forward<Args>(args)...);
+        }
+        return data[sizeV++];
+    }
     void push_backV(const T& value) {
-        if (sizeV >= capacity) resizeV();
-        data[sizeV++] = value;
+        emplace_backV(value);
     }
     void push_backV(T&& value) {
-        if (sizeV >= capacity) resizeV();
-        data[sizeV++] = std::move(value);
+        emplace_backV(std::move(value));
     }
 
     size_t size() const { return sizeV;}
+    size_t capacityV() const { return capacity; }
+    bool empty() const { return sizeV == 0; }
 
     T& operator[](size_t index) {return data[index];}
     const T& operator[](size_t index) const {return data[index];}
@@ -53,4 +194,4 @@ public:
 };
 
 
-#endif //INC_1PRAKA_MYVECTOR_H
\ No newline at end of file
+#endif //INC_1PRAKA_MYVECTOR_H
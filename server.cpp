@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <sys/resource.h>
 #include <sys/socket.h>
 
 #include <unistd.h>
@@ -8,28 +10,37 @@
 #include <cstring>
 #include <sstream>
 #include <chrono>
+#include "Catalog.h"
 #include "Database.h"
+#include "Epoch.h"
+#include "Frame.h"
+#include "IdGenerator.h"
+#include "Logger.h"
+#include "Reactor.h"
+#include "ThreadPool.h"
+#include "WorkStealingPool.h"
+#include "WriteAheadLog.h"
 
 using namespace std;
 using json = nlohmann::json;
 
 const int PORT = 8080;
+// предел сообщения без кадра от старых клиентов; кадры ограничены MAX_REQUEST_FRAME
 const int BUFFER_SIZE = 8192;
-const int MAX_CLIENTS = 100;
+const int LISTEN_BACKLOG = 4096;
+// сколько запросов клиент с кадрами может прислать, не дожидаясь ответов
+const int MAX_IN_FLIGHT = 128;
 const int SOCKET_TIMEOUT_SEC = 60;
-
-mutex MapMutex;
-map<string, unique_ptr<mutex>> databaseMutex;
-mutex countMutex;
-
-mutex& getDbMutex(const string& dbName) {
-    lock_guard<mutex> lock(MapMutex);
-
-    if (databaseMutex.find(dbName) == databaseMutex.end()) {
-        databaseMutex[dbName] = make_unique<mutex>();
-    }
-    return *databaseMutex[dbName];
-}
+// потоки epoll и потоки исполнителя, меняются через --io-threads и --workers;
+// 0 исполнителей — по числу ядер. Исполнителей не больше Epoch::READER_SLOTS:
+// каждый может держать снимок коллекции, и лишние ждали бы свободной ячейки
+const int IO_THREADS = 2;
+const int EXECUTOR_THREADS = 0;
+// сколько запросов может ждать в очереди одного исполнителя
+const int EXECUTOR_QUEUE_CAPACITY = 1024;
+// параметры группового коммита журнала, меняются через --flush-interval и --batch-size
+const int COMMIT_FLUSH_INTERVAL_MS = 1;
+const int COMMIT_BATCH_SIZE = 64;
 
 string threadIdToString(thread::id id) {
     stringstream ss;
@@ -37,241 +48,227 @@ string threadIdToString(thread::id id) {
     return ss.str();
 }
 
-// Функция для установки таймаута на сокет
-bool setSocketTimeout(int socket, int seconds) {
-    timeval timeout;
-    timeout.tv_sec = seconds;
-    timeout.tv_usec = 0;
-
-    if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
-        return false;
+// Ответ на запрос. Если written не пусто, отправлять его можно только
+// после written->waitDurable(commitTicket).
+struct Reply {
+    string response;
+    Collection* written = nullptr;
+    uint64_t commitTicket = 0;
+    json requestId;  // для ответа об ошибке, если запись не дойдёт до диска
+};
+
+// Запись не попала в журнал и откачена. Это не ошибка запроса: клиент
+// может повторить его, когда диск снова будет принимать записи
+string notDurableResponse(const json& requestId, const LogWriteError& e) {
+    json response;
+    response["status"] = "error";
+    response["message"] = "write is not durable: " + string(e.what());
+    if (!requestId.is_null()) {
+        response["id"] = requestId;
     }
-
-    if (setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
-        return false;
-    }
-
-    return true;
+    return response.dump();
 }
 
-// Функция для отправки данных с таймаутом
-bool sendWithTimeout(int socket, const string& data) {
-    const char* buffer = data.c_str();
-    size_t totalSent = 0;
-    size_t dataSize = data.length();
-
-    auto start = chrono::steady_clock::now();
-
-    while (totalSent < dataSize) {
-        int sent = send(socket, buffer + totalSent, dataSize - totalSent, 0);
-
-        if (sent < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Таймаут отправки
-                auto now = chrono::steady_clock::now();
-                auto elapsed = chrono::duration_cast<chrono::seconds>(now - start).count();
-
-                if (elapsed >= SOCKET_TIMEOUT_SEC) {
-                    lock_guard<mutex> lock(countMutex);
-                    cout << "[-] Таймаут отправки данных клиенту" << endl;
-                    return false;
-                }
-                continue;
-            }
-
-            lock_guard<mutex> lock(countMutex);
-            cout << "[-] Ошибка отправки данных: " << strerror(errno) << endl;
-            return false;
-        }
-
-        totalSent += sent;
+// id возвращаем, если запрос успел разобраться, чтобы клиент с
+// несколькими запросами в полёте понял, на какой пришла ошибка
+string errorResponse(const json& requestId, const exception& e) {
+    json response;
+    response["status"] = "error";
+    response["message"] = "JSON parsing error: " + string(e.what());
+    if (!requestId.is_null()) {
+        response["id"] = requestId;
     }
-
-    return true;
+    return response.dump();
 }
 
-void handleClient(int clientSocket, sockaddr_in clientAddress) {
-    string threadId = threadIdToString(this_thread::get_id());
-
-    {
-        lock_guard<mutex> lock(countMutex);
-        char clientIP[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-        cout << "[+] Клиент подключен: " << clientIP << ":"
-                  << ntohs(clientAddress.sin_port)
-                  << " (Поток: " << threadId << ")" << endl;
-    }
-
-    // Устанавливаем таймаут на сокет
-    if (!setSocketTimeout(clientSocket, SOCKET_TIMEOUT_SEC)) {
-        lock_guard<mutex> lock(countMutex);
-        cout << "[-] Ошибка установки таймаута для клиента" << endl;
-        close(clientSocket);
-        return;
-    }
-
-    char buffer[BUFFER_SIZE];
-    bool connectionAlive = true;
-
-    while (connectionAlive) {
-        HashMap map(3);
-        memset(buffer, 0, BUFFER_SIZE);
-
-        auto recvStart = chrono::steady_clock::now();
-        int bytesRead = recv(clientSocket, buffer, BUFFER_SIZE - 1, 0);
-
-        if (bytesRead < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                auto now = chrono::steady_clock::now();
-                auto elapsed = chrono::duration_cast<chrono::seconds>(now - recvStart).count();
-
-                if (elapsed >= SOCKET_TIMEOUT_SEC) {
-                    lock_guard<mutex> lock(countMutex);
-                    char clientIP[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-                    cout << "[-] Таймаут ожидания данных от клиента: " << clientIP << endl;
-                }
-                break;
+// Выполняет один запрос клиента в потоке исполнителя. Ожидание fsync
+// сюда не входит: его делают отдельные потоки, чтобы исполнители,
+// которых столько же, сколько ядер, не простаивали на диске.
+Reply processRequest(const string& message, const string& clientIP) {
+    json inMsg;
+    try {
+        inMsg = json::parse(message);
+        string database = inMsg["database"];
+        string collection = inMsg["collection"];
+        string op = inMsg["operation"];
+
+        // строку журнала собираем, только если её действительно запишут
+        if (Logger::enabled(LogLevel::Info) && Logger::sampleRequest()) {
+            string entry = "[" + clientIP + ", поток: " + threadIdToString(this_thread::get_id()) + "] Получено: \n{\n";
+            entry += "\t\"database\": " + database + "\n";
+            entry += "\t\"collection\": " + collection + "\n";
+            entry += "\t\"operation\": " + op + "\n";
+            if (op == "insert") {
+                entry += "\t\"data\": " + inMsg["data"].dump(15) + "\n";
+            } else if (op == "createIndex" || op == "dropIndex") {
+                entry += "\t\"field\": " + inMsg["field"].dump() + "\n";
+                entry += "\t\"type\": " + inMsg.value("type", "hash") + "\n";
+            } else {
+                entry += "\t\"query\": " + inMsg["query"].dump(10) + "\n";
             }
-
-            lock_guard<mutex> lock(countMutex);
-            char clientIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-            cout << "[-] Ошибка приема данных от клиента " << clientIP
-                      << ": " << strerror(errno) << endl;
-            break;
-        }
-
-        if (bytesRead == 0) {
-            lock_guard<mutex> lock(countMutex);
-            char clientIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-            cout << "[-] Клиент отключился корректно: " << clientIP << endl;
-            break;
+            entry += "}";
+            Logger::log(LogLevel::Info, std::move(entry));
         }
 
-        try {
-            json inMsg = json::parse(buffer);
-            string database = inMsg["database"];
-            string collection = inMsg["collection"];
-            string op = inMsg["operation"];
-
-            {
-                lock_guard<mutex> lock(countMutex);
-                char clientIP[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-                cout << "[" << clientIP << ", поток: "<< threadId << "] " << "Получено: \n{" << endl;
-                cout << "\t\"database\": " << database << endl;
-                cout << "\t\"collection\": " << collection << endl;
-                cout << "\t\"operation\": " << op << endl;
-                if (op == "insert") {
-                    cout << "\t\"data\": " << inMsg["data"].dump(15) << endl;
-                } else {
-                    cout << "\t\"query\": " << inMsg["query"].dump(10) << endl;
-                }
-                cout << "}" << endl;
-            }
-
-            filesystem::create_directories(database);
-            string filename = database + "/" + collection + ".json";
-
-            bool status = true;
-            int inputCount;
-            json data = json::array();
-
-            json input;
+        bool status = true;
+        int inputCount = 0;
+        json data = json::array();
 
-            mutex& dbMutex = getDbMutex(database);
-            lock_guard<mutex> db_lock(dbMutex);
+        json input;
 
-            auto dbOperationStart = chrono::steady_clock::now();
+        auto dbOperationStart = chrono::steady_clock::now();
 
-            map.loadFromFile(filename);
+        uint64_t commitTicket = 0;
+        Collection* written = nullptr;
+        {
+            Collection& coll = Catalog::getCollection(database, collection);
+            // find читает снимок и писателей не ждёт, писатели идут по одному
+            unique_lock<mutex> writeLock(coll.getWriteLock(), defer_lock);
+            if (op != "find") {
+                writeLock.lock();
+            }
             if (op == "insert") {
-                if (Database::insertDoc(&map, inMsg["data"].dump())) {
-                    map.saveToFile(filename);
+                if (Database::insertDoc(&coll, std::move(inMsg["data"]))) {
                     status = true;
                 } else {
                     status = false;
                 }
             }
             else if (op == "find") {
-                auto [count, docs] = Database::findDoc(&map, inMsg["query"].dump());
+                auto [count, docs] = Database::findDoc(&coll, inMsg["query"]);
                 if (count == 0) {
                     status = false;
                     input["message"] = "no documents found";
                 }
                 else {
                     status = true;
-                    data = docs;
+                    data = std::move(docs);
                     inputCount = count;
                     input["message"] = to_string(count) + " documents found";
                 }
             } else if (op == "delete") {
-                auto [count, docs] = Database::deleteDoc(&map, inMsg["query"].dump());
+                auto [count, docs] = Database::deleteDoc(&coll, inMsg["query"]);
                 if (count == 0) {
                     status = false;
                     input["message"] = "no documents to delete were found";
                 }
                 else {
                     status = true;
-                    data = docs;
+                    data = std::move(docs);
                     inputCount = count;
-                    map.saveToFile(filename);
                     input["message"] = to_string(count) + " documents deleted";
                 }
+            } else if (op == "createIndex") {
+                const string field = inMsg["field"];
+                const string type = inMsg.value("type", "hash");
+                status = Database::createIndex(&coll, field, type);
+                input["message"] = status ? type + " index on " + field + " created"
+                                          : type + " index on " + field + " already exists or is invalid";
+            } else if (op == "dropIndex") {
+                const string field = inMsg["field"];
+                const string type = inMsg.value("type", "hash");
+                status = Database::dropIndex(&coll, field, type);
+                input["message"] = status ? type + " index on " + field + " dropped"
+                                          : "no " + type + " index on " + field;
             }
-
-            // Проверяем таймаут операции с БД
-            auto dbOperationEnd = chrono::steady_clock::now();
-            auto dbOperationDuration = chrono::duration_cast<chrono::seconds>(dbOperationEnd - dbOperationStart).count();
-            if (dbOperationDuration > 5) {
-                lock_guard<mutex> lock(countMutex);
-                cout << "[!] Долгая операция с БД: " << dbOperationDuration << " сек" << endl;
-            }
-
-            input["status"] = status ? "success" : "error";
-            if (!input.contains("message")) {
-                input["message"] = status ? "operation is completed" : "operation failed";
-            }
-            if (op != "insert" && status) {
-                input["data"] = data;
-                input["count"] = inputCount;
+            if (op == "insert" || (op == "delete" && status)) {
+                commitTicket = coll.commitTicket();
+                written = &coll;
             }
-            string response = input.dump();
-
-            if (!sendWithTimeout(clientSocket, response)) {
-                connectionAlive = false;
-            }
-        } catch (const exception& e) {
-            json errorResponse;
-            errorResponse["status"] = "error";
-            errorResponse["message"] = "JSON parsing error: " + string(e.what());
-            string response = errorResponse.dump();
+        }
 
-            if (!sendWithTimeout(clientSocket, response)) {
-                connectionAlive = false;
-            }
+        // Проверяем таймаут операции с БД
+        auto dbOperationEnd = chrono::steady_clock::now();
+        auto dbOperationDuration = chrono::duration_cast<chrono::seconds>(dbOperationEnd - dbOperationStart).count();
+        if (dbOperationDuration > 5) {
+            Logger::log(LogLevel::Warn, "[!] Долгая операция с БД: " + to_string(dbOperationDuration) + " сек");
         }
 
-        if (strcmp(buffer, "exit") == 0) {
-            lock_guard<mutex> lock(countMutex);
-            char clientIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &clientAddress.sin_addr, clientIP, INET_ADDRSTRLEN);
-            cout << "[-] Клиент запросил выход: " << clientIP << endl;
-            break;
+        input["status"] = status ? "success" : "error";
+        if (inMsg.contains("id")) {
+            input["id"] = inMsg["id"];
+        }
+        if (!input.contains("message")) {
+            input["message"] = status ? "operation is completed" : "operation failed";
         }
+        if ((op == "find" || op == "delete") && status) {
+            input["data"] = std::move(data);
+            input["count"] = inputCount;
+        }
+        json requestId = inMsg.contains("id") ? inMsg["id"] : json();
+        return {input.dump(), written, commitTicket, std::move(requestId)};
+    } catch (const LogWriteError& e) {
+        Reply failed;
+        failed.response = notDurableResponse(inMsg.is_object() && inMsg.contains("id") ? inMsg["id"] : json(), e);
+        return failed;
+    } catch (const exception& e) {
+        Reply failed;
+        failed.response = errorResponse(inMsg.is_object() && inMsg.contains("id") ? inMsg["id"] : json(), e);
+        return failed;
     }
+}
 
-    close(clientSocket);
-
-    {
-        lock_guard<mutex> lock(countMutex);
-        cout << "[-] Поток " << threadId << " завершил обработку клиента" << endl;
+int main(int argc, char* argv[]) {
+    int flushIntervalMs = COMMIT_FLUSH_INTERVAL_MS;
+    int batchSize = COMMIT_BATCH_SIZE;
+    int ioThreads = IO_THREADS;
+    int workerThreads = EXECUTOR_THREADS;
+    LogLevel logLevel = LogLevel::Info;
+    int logSample = 1;
+    int nodeId = 0;
+    try {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const string arg = argv[i];
+            if (arg == "--flush-interval") {
+                flushIntervalMs = stoi(argv[i + 1]);
+            } else if (arg == "--batch-size") {
+                batchSize = stoi(argv[i + 1]);
+            } else if (arg == "--io-threads") {
+                ioThreads = stoi(argv[i + 1]);
+            } else if (arg == "--workers") {
+                workerThreads = stoi(argv[i + 1]);
+            } else if (arg == "--log-level") {
+                if (!Logger::parseLevel(argv[i + 1], logLevel)) {
+                    cerr << "Неизвестный уровень журнала: " << argv[i + 1] << endl;
+                    return 1;
+                }
+            } else if (arg == "--log-sample") {
+                logSample = stoi(argv[i + 1]);
+            } else if (arg == "--node-id") {
+                nodeId = stoi(argv[i + 1]);
+            } else {
+                cerr << "Неизвестный параметр: " << arg << endl;
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Неверное значение параметра: " << e.what() << endl;
+        return 1;
+    }
+    if (flushIntervalMs < 0 || batchSize < 1 || ioThreads < 1 || workerThreads < 0 || logSample < 0
+        || workerThreads > static_cast<int>(Epoch::READER_SLOTS)
+        || nodeId < 0 || nodeId > static_cast<int>(IdGenerator::MAX_NODE)) {
+        cerr << "Использование: " << argv[0] << " [--flush-interval <мс>] [--batch-size <N>]"
+             << " [--io-threads <N>] [--workers 0.." << Epoch::READER_SLOTS << "]"
+             << " [--log-level debug|info|warn|error|off] [--log-sample <N>]"
+             << " [--node-id 0.." << IdGenerator::MAX_NODE << "]" << endl;
+        return 1;
+    }
+    if (workerThreads == 0) {
+        workerThreads = static_cast<int>(min<size_t>(thread::hardware_concurrency(), Epoch::READER_SLOTS));
+    }
+    Logger::setLevel(logLevel);
+    Logger::setRequestSampling(logSample);
+    IdGenerator::setNode(nodeId);
+    WriteAheadLog::configure(chrono::milliseconds(flushIntervalMs), batchSize);
+
+    // каждое соединение — это дескриптор, поднимаем мягкий предел до жёсткого
+    rlimit files{};
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
     }
-}
 
-int main() {
     //создаём сокет
     int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (serverSocket < 0) {
@@ -286,13 +283,6 @@ int main() {
         return 1;
     }
 
-    timeval timeout{};
-    timeout.tv_sec = 5;
-    timeout.tv_usec = 0;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
-        cerr << "Ошибка установки таймаута accept" << endl;
-    }
-
     sockaddr_in serverAddress{};
     serverAddress.sin_family = AF_INET;
     serverAddress.sin_addr.s_addr = INADDR_ANY;
@@ -305,7 +295,7 @@ int main() {
         return 1;
     }
 
-    if (listen(serverSocket, MAX_CLIENTS) < 0) {
+    if (listen(serverSocket, LISTEN_BACKLOG) < 0) {
         cerr << "Ошибка при прослушивании порта" << endl;
         close(serverSocket);
         return 1;
@@ -313,40 +303,74 @@ int main() {
 
     cout << "=== Сервер запущен на порту " << PORT << " ===" << endl;
     cout << "Таймаут сокета: " << SOCKET_TIMEOUT_SEC << " секунд" << endl;
-    cout << "Ожидание подключений..." << endl;
-
-    vector<thread> clientThreads;
-
-    while (true) {
-        sockaddr_in clientAddress{};
-        socklen_t clientSize = sizeof(clientAddress);
+    cout << "Групповой коммит: " << flushIntervalMs << " мс, до " << batchSize << " записей" << endl;
+    WorkStealingPool executor(workerThreads, EXECUTOR_QUEUE_CAPACITY);
+    // запись ждёт общий fsync журнала; ждущих потоков столько, сколько
+    // записей входит в одну пачку группового коммита
+    ThreadPool commitWaiters(batchSize);
 
-        int clientSocket = accept(serverSocket, reinterpret_cast<struct sockaddr *>(&clientAddress), &clientSize);
+    cout << "Потоки ввода-вывода: " << ioThreads << ", исполнители: " << executor.size() << endl;
+    cout << "Ожидание подключений..." << endl;
+    // дальше stdout пишет только фоновый поток журнала
+    Logger::start();
 
-        if (clientSocket < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Таймаут accept, продолжаем цикл
-                continue;
-            }
-            cerr << "Ошибка при принятии подключения: " << strerror(errno) << endl;
-            continue;
+    ReactorCallbacks callbacks;
+    callbacks.onOpen = [](const ConnectionPtr& conn) {
+        if (Logger::enabled(LogLevel::Info)) {
+            Logger::log(LogLevel::Info, "[+] Клиент подключен: " + conn->peer);
         }
-
-        clientThreads.emplace_back(handleClient, clientSocket, clientAddress);
-
-        clientThreads.back().detach();
-
-        for (auto it = clientThreads.begin(); it != clientThreads.end(); ) {
-            if (!it->joinable()) {
-                it = clientThreads.erase(it);
-            } else {
-                ++it;
+    };
+    callbacks.onRequest = [&executor, &commitWaiters](const ConnectionPtr& conn, string& message) {
+        auto request = make_shared<string>(std::move(message));
+        const bool accepted = executor.trySubmit([conn, request, &commitWaiters] {
+            const bool closeAfter = *request == "exit";
+            const string clientIP = conn->peer.substr(0, conn->peer.rfind(':'));
+            Reply reply = processRequest(*request, clientIP);
+            if (reply.written == nullptr) {
+                Reactor::respond(conn, std::move(reply.response), closeAfter);
+                return;
             }
+            // отвечаем только после того, как запись попала на диск;
+            // fsync общий для всех писателей, ожидающих в этот момент.
+            // Следующий запрос соединения можно выполнять уже сейчас.
+            Reactor::release(conn);
+            commitWaiters.submit([conn, reply = std::move(reply), closeAfter]() mutable {
+                try {
+                    reply.written->waitDurable(reply.commitTicket);
+                } catch (const LogWriteError& e) {
+                    // пакет не записался: коллекция уже откатила эту запись в памяти
+                    Logger::log(LogLevel::Error, string("Ошибка журнала: ") + e.what());
+                    reply.response = notDurableResponse(reply.requestId, e);
+                } catch (const exception& e) {
+                    Logger::log(LogLevel::Error, string("Ошибка журнала: ") + e.what());
+                    reply.response = errorResponse(reply.requestId, e);
+                }
+                Reactor::deliver(conn, std::move(reply.response), closeAfter);
+            });
+        });
+        if (!accepted) {
+            // очереди полны: реактор повторит запрос позже
+            message = std::move(*request);
         }
-
-        {
-            lock_guard<mutex> lock(countMutex);
-            cout << "[Статистика] Активных потоков: " << clientThreads.size() << endl;
+        return accepted;
+    };
+    callbacks.onClose = [](const ConnectionPtr& conn, const string& reason) {
+        if (Logger::enabled(LogLevel::Info)) {
+            Logger::log(LogLevel::Info, "[-] " + reason + ": " + conn->peer);
         }
+    };
+
+    try {
+        Reactor reactor(serverSocket, ioThreads,
+                        {BUFFER_SIZE, MAX_REQUEST_FRAME, MAX_IN_FLIGHT, chrono::seconds(SOCKET_TIMEOUT_SEC)}, std::move(callbacks));
+        reactor.run();
+    } catch (const exception& e) {
+        Logger::stop();
+        cerr << "Ошибка запуска сервера: " << e.what() << endl;
+        close(serverSocket);
+        return 1;
     }
-}
\ No newline at end of file
+    Logger::stop();
+    close(serverSocket);
+    return 0;
+}
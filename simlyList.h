@@ -1,35 +1,118 @@
 #ifndef SIMLYLIST_H
 #define SIMLYLIST_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include "json.hpp"
 
+#include "BinaryDocument.h"
 #include "myVector.h"
+#include "SlabPool.h"
 
+// Список корзины хеш-таблицы. Меняет его только писатель, а читатели идут
+// по нему без замков: новый узел публикуется в голове уже готовым, а
+// удаление сначала только помечает узел версией (markDeleted) и вынимает его
+// из цепочки позже (unlinkDeleted), когда старых читателей не останется.
+//
+// Узлы и документы берутся из пулов таблицы (Storage), а не из кучи по одному.
 class SimplyList {
 private:
-    struct SimplyNode{
+    struct SimplyNode;
+public:
+    // Документ вместе с id. При рехешировании копируется только узел,
+    // а документ остаётся общим у узла и его копий; refs меняет только писатель.
+    struct Document {
         std::string id_;
-        nlohmann::json data;
-        SimplyNode* next;
+        BinaryDocument data;
+        uint32_t refs = 1;
 
-        SimplyNode(const std::string&  id, const nlohmann::json&  value);
+        Document(const std::string& id, BinaryDocument&& value) : id_(id), data(std::move(value)) {}
+
+        static void* operator new(size_t) = delete;
+        static void* operator new(size_t, SlabPool<Document>& pool) { return pool.allocate(); }
+        static void operator delete(void* document) { SlabPool<Document>::release(document); }
+        static void operator delete(void* document, SlabPool<Document>&) { SlabPool<Document>::release(document); }
+    };
+    // пулы одной таблицы: узлы и документы лежат в своих слэбах, а не по всей куче;
+    // fields — имена полей, на которые ссылаются документы
+    struct Storage {
+        SlabPool<SimplyNode> nodes;
+        SlabPool<Document> documents;
+        FieldDictionary fields;
     };
-    SimplyNode* head;
+private:
+    struct SimplyNode{
+        Document* document;
+        std::atomic<SimplyNode*> next;
+        uint64_t created;               // версия, с которой узел виден
+        std::atomic<uint64_t> deleted;  // версия удаления, 0 — не удалён
+        size_t origin;                  // корзина старой таблицы, если узел — копия при рехешировании
+
+        SimplyNode(Document* shared, uint64_t version);
+        ~SimplyNode();
+
+        [[nodiscard]] const std::string& key() const { return document->id_; }
+        [[nodiscard]] const BinaryDocument& value() const { return document->data; }
+        [[nodiscard]] bool visibleAt(const uint64_t version) const {
+            const uint64_t removed = deleted.load(std::memory_order_acquire);
+            return created <= version && (removed == 0 || removed > version);
+        }
+        [[nodiscard]] bool live() const { return deleted.load(std::memory_order_relaxed) == 0; }
+
+        // узел создаётся только в пуле: new (pool) SimplyNode(...)
+        static void* operator new(size_t) = delete;
+        static void* operator new(size_t, SlabPool<SimplyNode>& pool) { return pool.allocate(); }
+        static void operator delete(void* node) { SlabPool<SimplyNode>::release(node); }
+        static void operator delete(void* node, SlabPool<SimplyNode>&) { SlabPool<SimplyNode>::release(node); }
+    };
+    std::atomic<SimplyNode*> head;
     SimplyNode* tail;
+    Storage* storage;
+
+    void link(SimplyNode* node);
 public:
-    SimplyList();
+    static constexpr size_t NO_ORIGIN = SIZE_MAX;
+
+    explicit SimplyList(Storage& pools);
     ~SimplyList();
 
-    [[nodiscard]] nlohmann::json getData() const {return head->data;}
-    [[nodiscard]] SimplyNode * getHead() const { return head; }
+    SimplyList(const SimplyList&) = delete;
+    SimplyList& operator=(const SimplyList&) = delete;
+
+    [[nodiscard]] nlohmann::json getData() const {return head.load()->value().toJson(storage->fields);}
+    [[nodiscard]] SimplyNode * getHead() const { return head.load(std::memory_order_acquire); }
     [[nodiscard]] SimplyNode* getTail() const { return tail; }
 
     [[nodiscard]] MyVector<std::pair<std::string, nlohmann::json>> items() const;
-    void addHead(const std::string &key, const nlohmann::json &value);
+
+    // обход без копирования всех узлов, включая удалённые и ещё не видимые
+    template<typename F>
+    void forEachNode(F&& visit) const {
+        for (const SimplyNode* curr = head.load(std::memory_order_acquire); curr != nullptr;
+             curr = curr->next.load(std::memory_order_acquire)) {
+            visit(*curr);
+        }
+    }
+    // обход документов, видимых в версии version: visit(id, doc)
+    template<typename F>
+    void forEachAt(const uint64_t version, F&& visit) const {
+        forEachNode([&](const SimplyNode& node) {
+            if (node.visibleAt(version)) visit(node.key(), node.value());
+        });
+    }
+    const BinaryDocument& addHead(const std::string &key, BinaryDocument &&value, uint64_t version = 0);
+    // копия узла из корзины origin старой таблицы, с теми же версиями и тем же документом
+    void addCopy(const SimplyNode& node, size_t origin);
     void printList() const;
-    bool deleteByKey(const std::string& key);
+
+    bool markDeleted(const std::string& key, uint64_t version);
+    // вынимает из цепочки помеченный узел, но не освобождает его: читатели
+    // ещё могут на нём стоять
+    [[nodiscard]] SimplyNode* unlinkDeleted(const std::string& key);
 
     [[nodiscard]] std::pair<std::string, std::string> searchByKey(const std::string& key) const;
+    [[nodiscard]] const BinaryDocument* findByKey(const std::string& key) const;
+    [[nodiscard]] const BinaryDocument* findByKeyAt(const std::string& key, uint64_t version) const;
 };
-#endif
\ No newline at end of file
+#endif
@@ -7,87 +7,119 @@
 using namespace std;
 using namespace nlohmann;
 
-SimplyList::SimplyNode::SimplyNode(const string& id,const json& value) :
-                                    id_(std::move(id))
-                                    ,data(std::move(value))
-                                    ,next(nullptr){}
+SimplyList::SimplyNode::SimplyNode(Document* shared, const uint64_t version) :
+                                    document(shared)
+                                    ,next(nullptr)
+                                    ,created(version)
+                                    ,deleted(0)
+                                    ,origin(NO_ORIGIN){}
+
+SimplyList::SimplyNode::~SimplyNode() {
+    if (--document->refs == 0) delete document;
+}
 
-SimplyList::SimplyList() : head(nullptr), tail(nullptr) {}
+SimplyList::SimplyList(Storage& pools) : head(nullptr), tail(nullptr), storage(&pools) {}
 
 SimplyList::~SimplyList() {
-    while (head != nullptr) {
-        SimplyNode* temp = head;
-        head = head->next;
+    SimplyNode* curr = head.load(memory_order_relaxed);
+    while (curr != nullptr) {
+        SimplyNode* temp = curr;
+        curr = curr->next.load(memory_order_relaxed);
         delete temp;
     }
 }
 
 MyVector<pair<string,json>> SimplyList::items() const {
     MyVector<pair<string, json>> result;
-    for (SimplyNode* curr = head; curr != nullptr; curr = curr->next) {
-        result.push_backV(make_pair(curr->id_, curr->data));
-    }
+    forEachNode([this, &result](const SimplyNode& node) {
+        if (node.live()) result.emplace_backV(node.key(), node.value().toJson(storage->fields));
+    });
     return result;
 }
 
-void SimplyList::addHead(const string &key, const json &value) {
-    if (value.empty()) throw runtime_error("Значение пустое");
+// узел собран полностью до того, как читатели увидят его в голове
+void SimplyList::link(SimplyNode* node) {
+    node->next.store(head.load(memory_order_relaxed), memory_order_relaxed);
+    head.store(node, memory_order_release);
+    if (!tail) tail = node;
+}
+
+const BinaryDocument& SimplyList::addHead(const string &key, BinaryDocument &&value, const uint64_t version) {
+    if (value.fieldCount() == 0) throw runtime_error("Значение пустое");
     if (key.empty()) throw runtime_error("Id пустой");
-    const auto newNode = new SimplyNode(key, value);
-    newNode->next = head;
-    head = newNode;
-    if (!tail) tail = newNode;
+    Document* document = new (storage->documents) Document(key, std::move(value));
+    link(new (storage->nodes) SimplyNode(document, version));
+    return document->data;
 }
 
-bool SimplyList::deleteByKey(const string &key) {
-    if (head == nullptr) return false;
+void SimplyList::addCopy(const SimplyNode &node, const size_t origin) {
+    node.document->refs++;
+    const auto copy = new (storage->nodes) SimplyNode(node.document, node.created);
+    copy->deleted.store(node.deleted.load(memory_order_relaxed), memory_order_relaxed);
+    copy->origin = origin;
+    link(copy);
+}
 
-    if (head->id_ == key) {
-        const SimplyNode* temp = head;
-        head = head->next;
-        if (tail == temp) tail = nullptr;
-        delete temp;
-        return true;
+bool SimplyList::markDeleted(const string &key, const uint64_t version) {
+    for (SimplyNode* curr = head.load(memory_order_relaxed); curr != nullptr;
+         curr = curr->next.load(memory_order_relaxed)) {
+        if (curr->key() == key && curr->live()) {
+            curr->deleted.store(version, memory_order_release);
+            return true;
+        }
     }
+    return false;
+}
 
-    SimplyNode* current = head;
-    while (current->next != nullptr && current->next->id_ != key) {
-        current = current->next;
+SimplyList::SimplyNode* SimplyList::unlinkDeleted(const string &key) {
+    SimplyNode* prev = nullptr;
+    SimplyNode* curr = head.load(memory_order_relaxed);
+    while (curr != nullptr && (curr->key() != key || curr->live())) {
+        prev = curr;
+        curr = curr->next.load(memory_order_relaxed);
     }
-
-    if (current->next == nullptr) return false;
-
-    const SimplyNode* temp = current->next;
-    current->next = temp->next;
-
-    if (temp == tail) tail = current;
-
-    delete temp;
-    return true;
+    if (curr == nullptr) return nullptr;
+
+    // curr->next не трогаем: читатель, стоящий на curr, пройдёт дальше
+    SimplyNode* following = curr->next.load(memory_order_relaxed);
+    if (prev == nullptr) {
+        head.store(following, memory_order_release);
+    } else {
+        prev->next.store(following, memory_order_release);
+    }
+    if (tail == curr) tail = prev;
+    return curr;
 }
 
 
 void SimplyList::printList() const {
-    auto current = head;
-    int index = 0;
-    while (current != nullptr) {
-        cout << "[" << current->id_ << " : " << current->data << " ]";
+    forEachNode([this](const SimplyNode& node) {
+        if (!node.live()) return;
+        cout << "[" << node.key() << " : " << node.value().toJson(storage->fields) << " ]";
         cout << " -> ";
-        current = current->next;
-        index++;
-    }
+    });
     cout << "[NULL]" << endl;
 }
 
 pair<string, string> SimplyList::searchByKey(const std::string &key) const {
-    SimplyNode* current = head;
-    while (current != nullptr) {
-        if (current->id_ == key) {
-            return make_pair(current->id_, current->data.dump(4));
-        }
-        current = current ->next;
+    if (const BinaryDocument* doc = findByKey(key)) {
+        return make_pair(key, doc->toJson(storage->fields).dump(4));
     }
     return make_pair("", "");
 }
 
+const BinaryDocument* SimplyList::findByKey(const std::string &key) const {
+    for (const SimplyNode* current = head.load(memory_order_acquire); current != nullptr;
+         current = current->next.load(memory_order_acquire)) {
+        if (current->key() == key && current->live()) return &current->value();
+    }
+    return nullptr;
+}
 
+const BinaryDocument* SimplyList::findByKeyAt(const std::string &key, const uint64_t version) const {
+    for (const SimplyNode* current = head.load(memory_order_acquire); current != nullptr;
+         current = current->next.load(memory_order_acquire)) {
+        if (current->key() == key && current->visibleAt(version)) return &current->value();
+    }
+    return nullptr;
+}
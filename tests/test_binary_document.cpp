@@ -0,0 +1,182 @@
+// Проверки формата BinaryDocument: документ переживает кодирование без
+// потерь, а fromBytes отвергает байты снимка, которым нельзя доверять.
+//
+// Сборка и запуск из корня репозитория (лучше под ASAN: испорченные байты
+// не должны читаться за пределами буфера):
+//   g++ -std=c++17 -g -fsanitize=address,undefined -I. tests/test_binary_document.cpp BinaryDocument.cpp
+//       FieldDictionary.cpp RwLock.cpp -o test_binary_document && ./test_binary_document
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "BinaryDocument.h"
+#include "FieldDictionary.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    // раскладка объекта из BinaryDocument.h: uint32 размер, uint32 число полей,
+    // затем записи {uint32 номер поля, uint32 смещение значения}
+    const size_t OBJECT_HEADER = 2 * sizeof(uint32_t);
+    const size_t FIELD_ENTRY = 2 * sizeof(uint32_t);
+
+    int failures = 0;
+
+    void check(const bool condition, const string& what) {
+        if (!condition) {
+            failures++;
+            fprintf(stderr, "ОШИБКА: %s\n", what.c_str());
+        }
+    }
+
+    uint32_t readAt(const string& bytes, const size_t offset) {
+        uint32_t value;
+        memcpy(&value, bytes.data() + offset, sizeof(value));
+        return value;
+    }
+
+    void writeAt(string& bytes, const size_t offset, const uint32_t value) {
+        memcpy(&bytes[offset], &value, sizeof(value));
+    }
+
+    bool rejected(const string& bytes, const size_t length, const FieldDictionary& fields) {
+        try {
+            (void)BinaryDocument::fromBytes(bytes.data(), length, fields);
+        } catch (const runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    mt19937 rng(2024);
+
+    json randomValue(const int depth) {
+        const unsigned kind = rng() % (depth < 3 ? 11 : 9);
+        switch (kind) {
+            case 0: return nullptr;
+            case 1: return (rng() & 1) != 0;
+            case 2: return static_cast<int64_t>(rng()) - (1ll << 31);
+            case 3: return static_cast<uint64_t>(rng()) << 32 | rng();
+            case 4: return static_cast<double>(static_cast<int>(rng() % 20001) - 10000) / 64.0;
+            case 5: return string(rng() % 40, static_cast<char>('a' + rng() % 26));
+            case 6: return "";
+            case 7: return json::binary({1, 2, static_cast<uint8_t>(rng())}, static_cast<uint8_t>(rng() % 5));
+            case 8: return INT64_MIN;
+            case 9: {
+                json array = json::array();
+                for (unsigned i = rng() % 5; i > 0; i--) array.push_back(randomValue(depth + 1));
+                return array;
+            }
+            default: {
+                json object = json::object();
+                for (unsigned i = rng() % 5; i > 0; i--) object["f" + to_string(rng() % 12)] = randomValue(depth + 1);
+                return object;
+            }
+        }
+    }
+
+    void checkRoundTrip(const json& doc, FieldDictionary& fields) {
+        const BinaryDocument binary(doc, fields);
+        const json back = binary.toJson(fields);
+        check(back == doc && back.dump() == doc.dump(), "toJson(BinaryDocument(doc)) != doc: " + doc.dump());
+
+        const BinaryDocument loaded = BinaryDocument::fromBytes(binary.bytes(), binary.size(), fields);
+        check(loaded.toJson(fields) == doc, "документ из fromBytes отличается: " + doc.dump());
+
+        for (const auto& [name, value] : doc.items()) {
+            const BinaryDocument::Value found = binary.find(fields.find(name));
+            check(found && found.toJson(fields) == value, "find(" + name + ") вернул не то значение");
+        }
+        check(!binary.find(fields.intern("нет такого поля")), "find нашёл отсутствующее поле");
+    }
+}
+
+int main() {
+    FieldDictionary fields;
+
+    // все типы значений, пустые и вложенные контейнеры
+    checkRoundTrip(json::object(), fields);
+    checkRoundTrip({{"_id", "1"}, {"null", nullptr}, {"yes", true}, {"no", false}, {"int", -42},
+                    {"uint", UINT64_MAX}, {"float", 2.5}, {"text", "строка"}, {"empty", ""},
+                    {"bin", json::binary({0, 255, 7}, 3)}, {"array", {1, "два", nullptr, {{"x", 1}}}},
+                    {"object", {{"inner", {{"deep", json::array()}}}, {"list", json::object()}}}},
+                   fields);
+    for (int i = 0; i < 2000; i++) {
+        json doc = json::object();
+        for (unsigned f = rng() % 8; f > 0; f--) doc["f" + to_string(rng() % 12)] = randomValue(0);
+        checkRoundTrip(doc, fields);
+    }
+
+    const json sample = {{"_id", "42"}, {"name", "user"}, {"age", 30}, {"tags", {"a", "b"}},
+                         {"address", {{"city", "Омск"}, {"zip", 644000}}}};
+    const BinaryDocument binary(sample, fields);
+    const string bytes(binary.bytes(), binary.size());
+    check(!rejected(bytes, bytes.size(), fields), "fromBytes отверг целый документ");
+
+    // обрезанный буфер
+    for (size_t length = 0; length < bytes.size(); length++) {
+        check(rejected(bytes, length, fields), "принят документ, обрезанный до " + to_string(length) + " байт");
+    }
+
+    const uint32_t count = readAt(bytes, sizeof(uint32_t));
+    check(count == sample.size(), "неожиданное число полей в таблице");
+
+    // соседние записи таблицы полей переставлены: двоичный поиск в find сломался бы
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        string swapped = bytes;
+        const size_t first = OBJECT_HEADER + i * FIELD_ENTRY;
+        swapped.replace(first, FIELD_ENTRY, bytes, first + FIELD_ENTRY, FIELD_ENTRY);
+        swapped.replace(first + FIELD_ENTRY, FIELD_ENTRY, bytes, first, FIELD_ENTRY);
+        check(rejected(swapped, swapped.size(), fields), "принята таблица полей не по порядку");
+    }
+    {
+        string duplicated = bytes;
+        writeAt(duplicated, OBJECT_HEADER + FIELD_ENTRY, readAt(bytes, OBJECT_HEADER));
+        check(rejected(duplicated, duplicated.size(), fields), "принят повторный номер поля");
+
+        string unknown = bytes;
+        writeAt(unknown, OBJECT_HEADER + (count - 1) * FIELD_ENTRY, fields.size());
+        check(rejected(unknown, unknown.size(), fields), "принят номер поля, которого нет в словаре");
+
+        string outside = bytes;
+        writeAt(outside, OBJECT_HEADER + sizeof(uint32_t), static_cast<uint32_t>(bytes.size() + 100));
+        check(rejected(outside, outside.size(), fields), "принято смещение значения за концом документа");
+
+        string tooMany = bytes;
+        writeAt(tooMany, sizeof(uint32_t), UINT32_MAX);
+        check(rejected(tooMany, tooMany.size(), fields), "принято число полей больше размера документа");
+
+        string longer = bytes + "xx";
+        check(rejected(longer, longer.size(), fields), "принят буфер длиннее документа");
+    }
+
+    // случайная порча: документ либо отвергается, либо читается целиком без
+    // выхода за буфер (это видно под ASAN)
+    for (int i = 0; i < 20000; i++) {
+        string corrupted = bytes;
+        for (unsigned flips = 1 + rng() % 3; flips > 0; flips--) {
+            corrupted[rng() % corrupted.size()] = static_cast<char>(rng());
+        }
+        try {
+            const BinaryDocument doc = BinaryDocument::fromBytes(corrupted.data(), corrupted.size(), fields);
+            const json back = doc.toJson(fields);
+            // байты строк не проверяются, и dump может отказаться от неверного UTF-8
+            try {
+                (void)back.dump();
+            } catch (const json::type_error&) {
+            }
+        } catch (const runtime_error&) {
+        }
+    }
+
+    if (failures != 0) {
+        fprintf(stderr, "провалено проверок: %d\n", failures);
+        return 1;
+    }
+    printf("test_binary_document: ok\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Нагрузочная проверка чтения без замков: один писатель вставляет документы
+// с возрастающим seq и время от времени одной публикацией удаляет начало
+// диапазона, а читатели закрепляют версию и обходят таблицу. Любой снимок
+// обязан быть сплошным диапазоном seq без пропусков и повторов — и пока идёт
+// постепенное рехеширование, и когда удалённые узлы вынимаются из цепочек и
+// освобождаются через Epoch. Во втором прогоне читателей больше, чем
+// Epoch::READER_SLOTS: лишние ждут свободную ячейку.
+//
+// Сборка и запуск из корня репозитория, под TSAN и под ASAN:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -I. tests/test_mvcc.cpp hashMap.cpp simplyList.cpp Epoch.cpp
+//       BinaryDocument.cpp FieldDictionary.cpp RwLock.cpp -o test_mvcc && ./test_mvcc
+//   (то же с -fsanitize=address,undefined)
+// Запуск: ./test_mvcc [вставок на прогон, 50000]
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Epoch.h"
+#include "hashMap.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    // удаляется начало диапазона раз в столько вставок
+    const long DELETE_EVERY = 700;
+
+    atomic<long> failures{0};
+
+    void check(const bool condition, const string& what) {
+        if (!condition && failures++ < 10) {
+            fprintf(stderr, "ОШИБКА: %s\n", what.c_str());
+        }
+    }
+
+    string keyOf(const long seq) {
+        return "k" + to_string(seq);
+    }
+
+    struct Stats {
+        atomic<long> scans{0};
+        atomic<long> duringRehash{0};
+    };
+
+    // один снимок: seq всех видимых документов и поиск по id на той же версии
+    void readSnapshot(const HashMap& map, const uint32_t seqField, Stats& stats) {
+        const Epoch::Reader reader(map.getEpoch());
+        // таблицы освобождаются через Epoch, смотреть на них можно только отсюда
+        const bool rehashing = map.isRehashing();
+
+        vector<long> seen;
+        map.forEachAt(reader.version(), [&](const string& id, const BinaryDocument& doc) {
+            const long seq = doc.find(seqField).toJson(map.getFields()).get<long>();
+            check(id == keyOf(seq), "id " + id + " не совпадает с seq " + to_string(seq));
+            seen.push_back(seq);
+        });
+        stats.scans++;
+        if (rehashing) stats.duringRehash++;
+        if (seen.empty()) return;
+
+        sort(seen.begin(), seen.end());
+        const long low = seen.front(), high = seen.back();
+        check(adjacent_find(seen.begin(), seen.end()) == seen.end(), "документ виден дважды");
+        check(high - low + 1 == static_cast<long>(seen.size()),
+              "снимок не сплошной: " + to_string(seen.size()) + " документов в [" + to_string(low) + ", "
+              + to_string(high) + "]");
+
+        check(map.findByIdAt(keyOf(low), reader.version()) != nullptr, "findByIdAt не видит начало снимка");
+        check(map.findByIdAt(keyOf(high), reader.version()) != nullptr, "findByIdAt не видит конец снимка");
+        check(map.findByIdAt(keyOf(high + 1), reader.version()) == nullptr, "findByIdAt видит будущую вставку");
+        if (low > 0) {
+            check(map.findByIdAt(keyOf(low - 1), reader.version()) == nullptr, "findByIdAt видит удалённый");
+        }
+    }
+
+    void run(const size_t readers, const long inserts) {
+        // маленькая начальная ёмкость: рехеширование идёт почти всё время
+        HashMap map(3);
+        const uint32_t seqField = map.getFields().intern("seq");
+
+        atomic<bool> stop{false};
+        Stats stats;
+        vector<thread> threads;
+        for (size_t r = 0; r < readers; r++) {
+            threads.emplace_back([&] {
+                while (!stop.load(memory_order_relaxed)) readSnapshot(map, seqField, stats);
+            });
+        }
+
+        long deletedUpTo = 0;
+        for (long seq = 0; seq < inserts; seq++) {
+            map.hashMapInsert(keyOf(seq), json{{"_id", keyOf(seq)}, {"seq", seq}});
+            map.publish();
+            if (seq % DELETE_EVERY == DELETE_EVERY - 1) {
+                // половина оставшегося диапазона уходит одной публикацией
+                const long upTo = (deletedUpTo + seq) / 2;
+                for (; deletedUpTo < upTo; deletedUpTo++) {
+                    check(map.deleteById(keyOf(deletedUpTo)), "не удалось удалить " + keyOf(deletedUpTo));
+                }
+                map.publish();
+            }
+        }
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // читателей не осталось: удалённые вынимаются и освобождаются
+        map.publish();
+        long count = 0;
+        map.forEach([&count](const string&, const BinaryDocument&) { count++; });
+        check(count == inserts - deletedUpTo, "после прогона " + to_string(count) + " документов вместо "
+                                               + to_string(inserts - deletedUpTo));
+        printf("  читателей %zu: снимков %ld, во время рехеширования %ld, ёмкость %zu\n",
+               readers, stats.scans.load(), stats.duringRehash.load(), map.getCapacity());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const long inserts = argc > 1 ? stol(argv[1]) : 50000;
+
+    run(4, inserts);
+    run(Epoch::READER_SLOTS + 16, inserts / 5);
+
+    if (failures != 0) {
+        fprintf(stderr, "test_mvcc: ошибок %ld\n", failures.load());
+        return 1;
+    }
+    printf("test_mvcc: ok\n");
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Сверка скомпилированного Query по BinaryDocument с прежней семантикой
+// запросов над JSON: на случайных документах и запросах оба ответа должны
+// совпадать, включая сравнения чисел разных типов, NaN и вложенные $and/$or.
+//
+// Сборка и запуск из корня репозитория:
+//   g++ -std=c++17 -g -fsanitize=address,undefined -I. tests/test_query_equivalence.cpp Query.cpp BinaryDocument.cpp
+//       FieldDictionary.cpp RwLock.cpp -o test_query_equivalence && ./test_query_equivalence
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "BinaryDocument.h"
+#include "FieldDictionary.h"
+#include "Query.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    mt19937 rng(42);
+
+    // Прежний разбор $like по JSON, без подготовленных шаблонов
+    bool referenceLike(const string& text, const string& pattern) {
+        size_t pi = 0, ti = 0;
+        long lastMatch = -1, lastStar = -1;
+
+        while (ti < text.size()) {
+            if (pi < pattern.size() && (text[ti] == pattern[pi] || pattern[pi] == '_')) {
+                ti++;
+                pi++;
+            } else if (pi < pattern.size() && pattern[pi] == '%') {
+                lastStar = static_cast<long>(pi++);
+                lastMatch = static_cast<long>(ti);
+            } else if (lastStar != -1) {
+                ti = ++lastMatch;
+                pi = lastStar + 1;
+            } else return false;
+        }
+
+        while (pi < pattern.size() && pattern[pi] == '%') pi++;
+        return pi == pattern.size();
+    }
+
+    bool referenceCondition(const string& op, const json& operand, const json& value) {
+        const bool ordered = value.is_number() || value.is_string();
+        if (op == "$eq") return value == operand;
+        if (op == "$gt") return ordered && !(value <= operand);
+        if (op == "$gte") return ordered && !(value < operand);
+        if (op == "$lt") return ordered && !(value >= operand);
+        if (op == "$lte") return ordered && !(value > operand);
+        if (op == "$in") {
+            if (!operand.is_array()) return false;
+            for (const auto& item : operand) {
+                if (value == item) return true;
+            }
+            return false;
+        }
+        if (op == "$like") {
+            return operand.is_string() && value.is_string()
+                   && referenceLike(value.get<string>(), operand.get<string>());
+        }
+        // неизвестные операторы не ограничивают поле
+        return true;
+    }
+
+    // Прежняя семантика: $and и $or перекрывают остальные поля своего уровня,
+    // поле должно присутствовать в документе
+    bool referenceMatches(const json& query, const json& doc) {
+        if (!query.is_object()) return true;
+
+        if (const auto it = query.find("$and"); it != query.end()) {
+            for (const auto& part : *it) {
+                if (!referenceMatches(part, doc)) return false;
+            }
+            return true;
+        }
+        if (const auto it = query.find("$or"); it != query.end()) {
+            for (const auto& part : *it) {
+                if (referenceMatches(part, doc)) return true;
+            }
+            return false;
+        }
+
+        for (const auto& [field, condition] : query.items()) {
+            if (field[0] == '$') continue;
+            const auto value = doc.find(field);
+            if (value == doc.end()) return false;
+
+            if (!condition.is_object()) {
+                if (!(*value == condition)) return false;
+                continue;
+            }
+            for (const auto& [op, operand] : condition.items()) {
+                if (!referenceCondition(op, operand, *value)) return false;
+            }
+        }
+        return true;
+    }
+
+    json randomScalar() {
+        switch (rng() % 9) {
+            case 0: return nullptr;
+            case 1: return static_cast<bool>(rng() & 1);
+            case 2: return static_cast<int>(rng() % 7) - 3;
+            case 3: return static_cast<unsigned>(rng() % 7);
+            case 4: return static_cast<double>(rng() % 7) / 2.0 - 1.0;
+            case 5: {
+                string text;
+                for (int i = rng() % 4; i > 0; i--) text += static_cast<char>('a' + rng() % 3);
+                return text;
+            }
+            case 6: return "ab";
+            case 7: return nan("");
+            default: return 2;
+        }
+    }
+
+    json randomValue(const int depth) {
+        const int kind = rng() % 10;
+        if (depth < 2 && kind == 0) {
+            json array = json::array();
+            for (int i = rng() % 3; i > 0; i--) array.push_back(randomValue(depth + 1));
+            return array;
+        }
+        if (depth < 2 && kind == 1) {
+            json object = json::object();
+            for (int i = rng() % 3; i > 0; i--) object[string(1, 'a' + rng() % 4)] = randomValue(depth + 1);
+            return object;
+        }
+        return randomScalar();
+    }
+
+    const char* const FIELDS[] = {"a", "b", "c", "_id", "zz"};
+
+    json randomCondition() {
+        const char* const ops[] = {"$eq", "$gt", "$gte", "$lt", "$lte", "$in", "$like", "$unknown"};
+        const char* const patterns[] = {"a%", "ab", "%b", "_b", "", "%", "a%b"};
+        if (rng() % 3 == 0) return randomValue(1);
+
+        json condition = json::object();
+        for (int i = rng() % 3; i >= 0; i--) {
+            const string op = ops[rng() % 8];
+            if (op == "$in" && rng() % 4 != 0) {
+                json items = json::array();
+                for (int j = rng() % 3; j >= 0; j--) items.push_back(randomValue(1));
+                condition[op] = items;
+            } else if (op == "$like" && rng() % 4 != 0) {
+                condition[op] = patterns[rng() % 7];
+            } else {
+                condition[op] = randomValue(1);
+            }
+        }
+        return condition;
+    }
+
+    json randomQuery(const int depth) {
+        const int kind = rng() % 6;
+        if (depth < 2 && kind < 2) {
+            json parts = json::array();
+            for (int i = rng() % 3; i >= 0; i--) parts.push_back(randomQuery(depth + 1));
+            json query = {{kind == 0 ? "$and" : "$or", parts}};
+            // поля рядом с $and/$or не учитываются
+            if (rng() % 4 == 0) query[FIELDS[rng() % 5]] = randomCondition();
+            return query;
+        }
+        json query = json::object();
+        for (int i = rng() % 3; i > 0; i--) query[FIELDS[rng() % 5]] = randomCondition();
+        return query;
+    }
+}
+
+int main() {
+    FieldDictionary fields;
+    long checks = 0, hits = 0;
+
+    for (int d = 0; d < 3000; d++) {
+        json doc = json::object();
+        for (int i = rng() % 5; i > 0; i--) doc[FIELDS[rng() % 5]] = randomValue(0);
+        doc["_id"] = "id" + to_string(d);
+        const BinaryDocument encoded(doc, fields);
+
+        for (int q = 0; q < 30; q++) {
+            const json query = randomQuery(0);
+            Query compiled(query);
+            compiled.bind(fields);
+
+            const bool expected = referenceMatches(query, doc);
+            if (compiled.matches(encoded) != expected) {
+                fprintf(stderr, "ОШИБКА: документ %s, запрос %s: ожидалось %d\n",
+                        doc.dump().c_str(), query.dump().c_str(), expected);
+                return 1;
+            }
+            checks++;
+            hits += expected;
+        }
+    }
+
+    printf("test_query_equivalence: ok, %ld проверок, %ld совпадений\n", checks, hits);
+    return 0;
+}